@@ -1,6 +1,9 @@
 #include <cmath>
 #include "activation.h"
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <algorithm>
 namespace galanet::activation {
 
     Matrix tanh(const Matrix &m) {
@@ -85,4 +88,79 @@ namespace galanet::activation {
         }
         return res;
     }
+
+    void reluInPlace(Matrix &m, BitMask *mask) {
+        double *x = m.data();
+        const size_t n = (size_t)m.getRows() * m.getCols();
+        if (mask == nullptr) {
+            #pragma omp parallel for
+            for (size_t i = 0; i < n; i++)
+                x[i] = relu(x[i]);
+            return;
+        }
+        mask->resize(n);
+        #pragma omp parallel for
+        for (size_t w = 0; w < mask->num_words(); w++) {
+            uint64_t bits = 0;
+            const size_t end = std::min(n, (w + 1) * 64);
+            for (size_t i = w * 64; i < end; i++) {
+                bits |= uint64_t(x[i] > 0) << (i & 63);
+                x[i] = relu(x[i]);
+            }
+            mask->word(w) = bits;
+        }
+    }
+
+    void tanhInPlace(Matrix &m) {
+        double *x = m.data();
+        const size_t n = (size_t)m.getRows() * m.getCols();
+        #pragma omp parallel for
+        for (size_t i = 0; i < n; i++)
+            x[i] = std::tanh(x[i]);
+    }
+
+    void softmaxInPlace(Matrix &m) {
+        const int cols = m.getCols();
+        #pragma omp parallel for
+        for (int i = 0; i < m.getRows(); i++) {
+            double *row = m.data() + (size_t)i * cols;
+            double rowMax = -std::numeric_limits<double>::infinity();
+            for (int j = 0; j < cols; j++)
+                rowMax = std::max(rowMax, row[j]);
+            double sumExp = 0.0;
+            for (int j = 0; j < cols; j++) {
+                row[j] = std::exp(row[j] - rowMax);
+                sumExp += row[j];
+            }
+            for (int j = 0; j < cols; j++)
+                row[j] /= sumExp;
+        }
+    }
+
+    void reluBackward(Matrix &grad, const BitMask &mask) {
+        double *g = grad.data();
+        const size_t n = (size_t)grad.getRows() * grad.getCols();
+        if (mask.size() != n) throw std::invalid_argument("ReLU mask does not match gradient shape");
+        #pragma omp parallel for
+        for (size_t i = 0; i < n; i++)
+            g[i] *= mask.get(i) ? 1 : 0;
+    }
+
+    void tanhBackward(Matrix &grad, const Matrix &output) {
+        double *g = grad.data();
+        const double *y = output.data();
+        const size_t n = (size_t)grad.getRows() * grad.getCols();
+        #pragma omp parallel for
+        for (size_t i = 0; i < n; i++)
+            g[i] *= 1 - y[i] * y[i];
+    }
+
+    void softmaxBackward(Matrix &grad, const Matrix &output) {
+        double *g = grad.data();
+        const double *s = output.data();
+        const size_t n = (size_t)grad.getRows() * grad.getCols();
+        #pragma omp parallel for
+        for (size_t i = 0; i < n; i++)
+            g[i] *= s[i] * (1.0 - s[i]);
+    }
 }
\ No newline at end of file
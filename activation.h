@@ -2,6 +2,7 @@
 #define ACTIVATION_H
 
 #include "matrix.h"
+#include "bitmask.h"
 
 namespace galanet::activation {
     Matrix tanh(const Matrix &input);
@@ -14,6 +15,17 @@ namespace galanet::activation {
 
     Matrix softmax(const Matrix &input);
     Matrix softmaxDerivative(const Matrix &softmaxOutput);
+
+    // In-place forward variants; reluInPlace records (x > 0) in mask when given one.
+    void reluInPlace(Matrix &m, BitMask *mask);
+    void tanhInPlace(Matrix &m);
+    void softmaxInPlace(Matrix &m);
+
+    // Multiply grad in place by the activation derivative, using only what the
+    // forward pass kept: the sign mask for ReLU, the activation output otherwise.
+    void reluBackward(Matrix &grad, const BitMask &mask);
+    void tanhBackward(Matrix &grad, const Matrix &output);
+    void softmaxBackward(Matrix &grad, const Matrix &output);
 }
 
 #endif
\ No newline at end of file
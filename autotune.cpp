@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <set>
+#include <shared_mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "autotune.h"
+#include "matrix.h"
+
+namespace galanet::autotune {
+    struct Key {
+        GemmOp op;
+        int M, N, K; //M as its m_bucket()
+        int thread_limit; //OpenMP threads the caller may use
+        bool operator<(const Key &other) const{
+            return std::tie(op, M, N, K, thread_limit) < std::tie(other.op, other.M, other.N, other.K, other.thread_limit);
+        }
+    };
+    static const char *const op_names[] = {"nn", "nt", "tn", "tt"};
+
+    //Rows are independent, so shapes differing only in M share a winner within a
+    //power-of-two bucket, and everything from 512 rows up is one bucket; a ragged
+    //last batch then reuses the full batch's entry instead of being timed itself.
+    static constexpr int MAX_TUNED_ROWS = 512;
+    static int m_bucket(int M){
+        int bucket = 1;
+        while(bucket < M && bucket < MAX_TUNED_ROWS) bucket *= 2;
+        return bucket;
+    }
+
+    static std::atomic<bool> tuning_enabled{false};
+    static std::shared_mutex table_mutex;
+    static std::string cache_path;
+    static std::string host;       //cpu_key() of this machine
+    static int tuning_threads = 1; //thread limit of the thread that called enable()
+    static std::map<Key, GemmConfig> table;
+    static std::set<Key> in_flight; //shapes being timed right now
+    static std::vector<std::string> other_hosts; //cache lines for other CPUs, kept when saving
+
+    static int thread_limit(){
+    #ifdef _OPENMP
+        return omp_get_max_threads();
+    #else
+        return 1;
+    #endif
+    }
+
+    std::string cpu_key(){
+        std::string model = "unknown";
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while(std::getline(cpuinfo, line)){
+            if(line.rfind("model name", 0) != 0) continue;
+            size_t colon = line.find(':');
+            if(colon != std::string::npos){
+                model = line.substr(line.find_first_not_of(" \t", colon + 1));
+                break;
+            }
+        }
+        return model + " x" + std::to_string(std::thread::hardware_concurrency());
+    }
+
+    static void load(std::map<Key, GemmConfig> &entries, std::vector<std::string> &others){
+        entries.clear();
+        others.clear();
+        std::ifstream file(cache_path);
+        std::string line;
+        while(std::getline(file, line)){
+            if(line.empty() || line[0] == '#') continue;
+            std::istringstream fields(line);
+            std::string cpu, op;
+            Key key;
+            GemmConfig config;
+            if(!std::getline(fields, cpu, '\t') || !std::getline(fields, op, '\t')) continue;
+            if(cpu != host){
+                others.push_back(line);
+                continue;
+            }
+            auto name = std::find(std::begin(op_names), std::end(op_names), op);
+            if(name == std::end(op_names)) continue;
+            key.op = GemmOp(name - std::begin(op_names));
+            if(!(fields >> key.M >> key.N >> key.K >> key.thread_limit >> config.tile_m >> config.tile_k >> config.tile_n >> config.threads)) continue;
+            if(key.M != m_bucket(key.M)) continue; //exact M from an older cache, never looked up
+            entries[key] = config;
+        }
+    }
+
+    // Called with table_mutex held exclusively. Other processes (e.g. the workers of
+    // distributed::launch) tune into the same file, so under a file lock the cache is
+    // re-read and merged with our entries, then replaced through a temporary file
+    // unique to this process and thread, so readers never see a torn cache.
+    static void save(){
+        int lock_fd = open((cache_path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+        if(lock_fd >= 0) flock(lock_fd, LOCK_EX);
+        std::map<Key, GemmConfig> merged;
+        load(merged, other_hosts);
+        for(const auto &[key, config] : table)
+            merged[key] = config;
+        table.swap(merged);
+
+        std::string tmp = cache_path + ".tmp" + std::to_string(getpid()) + "." + std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id()));
+        bool written = false;
+        {
+            std::ofstream file(tmp);
+            if(file.is_open()){
+                file << "# galanet gemm tuning cache: cpu\top\tM\tN\tK\tthread_limit\ttile_m\ttile_k\ttile_n\tthreads\n";
+                for(const std::string &line : other_hosts)
+                    file << line << "\n";
+                for(const auto &[key, config] : table)
+                    file << host << "\t" << op_names[(int)key.op] << "\t" << key.M << "\t" << key.N << "\t" << key.K << "\t" << key.thread_limit
+                         << "\t" << config.tile_m << "\t" << config.tile_k << "\t" << config.tile_n << "\t" << config.threads << "\n";
+                written = file.good();
+            }
+        }
+        if(written) std::rename(tmp.c_str(), cache_path.c_str());
+        else std::remove(tmp.c_str());
+        if(lock_fd >= 0){
+            flock(lock_fd, LOCK_UN);
+            close(lock_fd);
+        }
+    }
+
+    void enable(const std::string &path){
+        std::unique_lock<std::shared_mutex> lock(table_mutex);
+        cache_path = path;
+        host = cpu_key();
+        tuning_threads = thread_limit();
+        load(table, other_hosts);
+        tuning_enabled = true;
+    }
+
+    void disable(){
+        tuning_enabled = false;
+    }
+
+    bool enabled(){
+        return tuning_enabled;
+    }
+
+    //best time of a few rounds, each long enough to be measurable
+    static double measure(const Matrix &a, bool transpose_a, const Matrix &b, bool transpose_b, Matrix &out, const GemmConfig &config){
+        using clock = std::chrono::steady_clock;
+        auto start = clock::now();
+        Matrix::gemm(a, transpose_a, b, transpose_b, out, 1.0, 0.0, config);
+        double once = std::chrono::duration<double>(clock::now() - start).count();
+        int reps = std::clamp((int)(1e-3 / std::max(once, 1e-9)), 1, 1000);
+        double best = std::numeric_limits<double>::infinity();
+        for(int round = 0; round < 3; round++){
+            start = clock::now();
+            for(int r = 0; r < reps; r++)
+                Matrix::gemm(a, transpose_a, b, transpose_b, out, 1.0, 0.0, config);
+            best = std::min(best, std::chrono::duration<double>(clock::now() - start).count() / reps);
+        }
+        return best;
+    }
+
+    // Coordinate search: thread count first, then each tile size in turn, timed
+    // with as many rows as the top of M's bucket.
+    static GemmConfig tune(GemmOp op, int M, int N, int K){
+        const bool transpose_a = op == GemmOp::TN || op == GemmOp::TT, transpose_b = op == GemmOp::NT || op == GemmOp::TT;
+        const int rows = m_bucket(M);
+        Matrix a = transpose_a ? Matrix(K, rows, 0.5) : Matrix(rows, K, 0.5);
+        Matrix b = transpose_b ? Matrix(N, K, 0.5) : Matrix(K, N, 0.5);
+        Matrix out;
+
+        const int max_threads = thread_limit();
+        GemmConfig best;
+        best.threads = max_threads;
+        double best_time = measure(a, transpose_a, b, transpose_b, out, best);
+        auto consider = [&](GemmConfig candidate) {
+            double t = measure(a, transpose_a, b, transpose_b, out, candidate);
+            if(t < best_time){
+                best_time = t;
+                best = candidate;
+            }
+        };
+        for(int threads : {1, max_threads / 2}){
+            if(threads < 1 || threads >= max_threads) continue;
+            GemmConfig candidate = best;
+            candidate.threads = threads;
+            consider(candidate);
+        }
+        GemmConfig base = best;
+        for(int tile_m : {4, 16, 64}){
+            if(tile_m > rows) break;
+            GemmConfig candidate = base;
+            candidate.tile_m = tile_m;
+            consider(candidate);
+        }
+        base = best;
+        for(int tile_k : {64, 256}){
+            if(tile_k >= K) break;
+            GemmConfig candidate = base;
+            candidate.tile_k = tile_k;
+            consider(candidate);
+        }
+        base = best;
+        for(int tile_n : {64, 256}){
+            if(tile_n >= N) break;
+            GemmConfig candidate = base;
+            candidate.tile_n = tile_n;
+            consider(candidate);
+        }
+        return best;
+    }
+
+    GemmConfig gemm_config(GemmOp op, int M, int N, int K){
+        if(!tuning_enabled) return GemmConfig();
+        const Key key{op, m_bucket(M), N, K, thread_limit()};
+        {
+            std::shared_lock<std::shared_mutex> lock(table_mutex);
+            auto it = table.find(key);
+            if(it != table.end()) return it->second;
+            //a thread held to part of the machine would time against the rest of the process
+            //and tune for a team size nobody else uses
+            if(key.thread_limit < tuning_threads) return GemmConfig();
+        }
+        {
+            std::unique_lock<std::shared_mutex> lock(table_mutex);
+            auto it = table.find(key);
+            if(it != table.end()) return it->second;
+            if(!in_flight.insert(key).second) return GemmConfig(); //another thread is timing this shape
+        }
+        //time without the lock so other shapes keep being served
+        GemmConfig config;
+        try {
+            config = tune(op, M, N, K);
+        } catch (...) {
+            std::unique_lock<std::shared_mutex> lock(table_mutex);
+            in_flight.erase(key);
+            throw;
+        }
+        std::unique_lock<std::shared_mutex> lock(table_mutex);
+        in_flight.erase(key);
+        table[key] = config;
+        save();
+        return config;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+#include <string>
+
+namespace galanet::autotune {
+    // Blocking and threading of one GEMM. A tile of 0 spans the whole dimension;
+    // threads == 1 runs serially, 0 uses the OpenMP default.
+    struct GemmConfig {
+        int tile_m = 1;
+        int tile_k = 0;
+        int tile_n = 0;
+        int threads = 0;
+    };
+
+    // Transposition of a and b.
+    enum class GemmOp { NN, NT, TN, TT };
+
+    // Turns tuning on. Winners are loaded from and saved to cache_path, keyed
+    // by CPU model and hardware thread count so one file can serve several hosts,
+    // and by the caller's OpenMP thread limit. Tuning only happens on threads
+    // allowed as many OpenMP threads as the thread calling enable(); threads
+    // restricted to fewer (e.g. sweep trials) only reuse cached winners.
+    void enable(const std::string &cache_path);
+    void disable();
+    bool enabled();
+
+    // Configuration for op with out = M x N and inner dimension K. The first
+    // request for a shape times a set of candidates and persists the fastest;
+    // M only counts up to the next power of two, capped at 512 rows;
+    // without tuning, or while another thread is tuning the same shape, the
+    // default configuration is returned.
+    GemmConfig gemm_config(GemmOp op, int M, int N, int K);
+
+    std::string cpu_key();
+}
+#endif
\ No newline at end of file
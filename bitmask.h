@@ -0,0 +1,45 @@
+#ifndef BITMASK_H
+#define BITMASK_H
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace galanet {
+    // Packed one-bit-per-element flags, used to remember which ReLU
+    // pre-activations were positive without keeping the pre-activations.
+    class BitMask {
+        public:
+            void resize(size_t num_bits) {
+                this->num_bits = num_bits;
+                words.assign((num_bits + 63) / 64, 0);
+            }
+            void set(size_t i, bool value) {
+                uint64_t bit = uint64_t(1) << (i & 63);
+                if (value) words[i >> 6] |= bit;
+                else words[i >> 6] &= ~bit;
+            }
+            bool get(size_t i) const {
+                return (words[i >> 6] >> (i & 63)) & 1;
+            }
+            //whole 64-bit words, so threads can fill disjoint words without racing
+            uint64_t &word(size_t w) {
+                return words[w];
+            }
+            uint64_t word(size_t w) const {
+                return words[w];
+            }
+            size_t num_words() const {
+                return words.size();
+            }
+            size_t size() const {
+                return num_bits;
+            }
+            size_t bytes() const {
+                return words.capacity() * sizeof(uint64_t);
+            }
+        private:
+            std::vector<uint64_t> words;
+            size_t num_bits = 0;
+    };
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include <stdexcept>
+#include <cstring>
+#include <fstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "dataset.h"
+
+namespace galanet {
+    struct ByteDataset::Storage {
+        std::vector<uint8_t> owned;
+        void *mapping = nullptr;
+        size_t mapping_bytes = 0;
+        ~Storage(){
+            if(mapping != nullptr) munmap(mapping, mapping_bytes);
+        }
+        size_t bytes() const{
+            return mapping != nullptr ? mapping_bytes : owned.size();
+        }
+    };
+
+    static uint32_t read_be32(const uint8_t *p){
+        return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+    }
+
+    ByteDataset::ByteDataset() {}
+
+    ByteDataset::ByteDataset(int num_rows, int num_cols, std::vector<uint8_t> bytes) : num_rows(num_rows), num_cols(num_cols) {
+        if(bytes.size() != (size_t)num_rows * num_cols) throw std::invalid_argument("Dataset size does not match its shape");
+        auto owned = std::make_shared<Storage>();
+        owned->owned = std::move(bytes);
+        base = owned->owned.data();
+        storage = owned;
+    }
+
+    ByteDataset ByteDataset::load_idx_images(const std::string &path, bool memory_map){
+        const size_t header = 16;
+        auto loaded = std::make_shared<Storage>();
+        const uint8_t *file_data = nullptr;
+        size_t file_bytes = 0;
+        if(memory_map){
+            int fd = open(path.c_str(), O_RDONLY);
+            if(fd < 0) throw std::runtime_error("Error opening file: " + path);
+            struct stat st;
+            if(fstat(fd, &st) != 0 || (size_t)st.st_size < header){
+                close(fd);
+                throw std::invalid_argument("Invalid MNIST file (too short)");
+            }
+            void *mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if(mapping == MAP_FAILED) throw std::runtime_error("mmap failed: " + path);
+            loaded->mapping = mapping;
+            loaded->mapping_bytes = st.st_size;
+            file_data = static_cast<const uint8_t *>(mapping);
+            file_bytes = st.st_size;
+        } else {
+            std::ifstream file(path, std::ios::binary);
+            if(!file.is_open()) throw std::runtime_error("Error opening file: " + path);
+            loaded->owned.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            if(loaded->owned.size() < header) throw std::invalid_argument("Invalid MNIST file (too short)");
+            file_data = loaded->owned.data();
+            file_bytes = loaded->owned.size();
+        }
+        if(read_be32(file_data) != 2051)
+            throw std::invalid_argument("Invalid MNIST file (magic number)");
+        uint32_t items = read_be32(file_data + 4);
+        uint32_t rows = read_be32(file_data + 8);
+        uint32_t cols = read_be32(file_data + 12);
+        if(file_bytes < header + (size_t)items * rows * cols)
+            throw std::invalid_argument("Invalid MNIST file (truncated)");
+
+        ByteDataset res;
+        res.storage = loaded;
+        res.base = file_data + header;
+        res.num_rows = items;
+        res.num_cols = rows * cols;
+        return res;
+    }
+
+    ByteDataset ByteDataset::slice(int start, int end) const{
+        if(start < 0 || end > num_rows || start > end) throw std::invalid_argument("Index out of bounds");
+        ByteDataset res = *this;
+        res.base = base + (size_t)start * num_cols;
+        res.num_rows = end - start;
+        return res;
+    }
+
+    void ByteDataset::set_scaling(double scale, double shift){
+        this->scale = scale;
+        this->shift = shift;
+    }
+
+    void ByteDataset::gather_rows(int start, int end, Matrix &out) const{
+        if(start < 0 || end > num_rows || start > end) throw std::invalid_argument("Index out of bounds");
+        out.resize(end - start, num_cols);
+        const uint8_t *src = base + (size_t)start * num_cols;
+        double *dst = out.data();
+        const size_t n = (size_t)(end - start) * num_cols;
+        const double scale = this->scale, shift = this->shift;
+        #pragma omp parallel for simd
+        for(size_t i = 0; i < n; i++)
+            dst[i] = src[i] * scale + shift;
+    }
+
+    void ByteDataset::gather(const std::vector<int> &indices, Matrix &out) const{
+        for(int index : indices)
+            if(index < 0 || index >= num_rows) throw std::invalid_argument("Index out of bounds");
+        out.resize(indices.size(), num_cols);
+        const double scale = this->scale, shift = this->shift;
+        const int cols = num_cols;
+        #pragma omp parallel for
+        for(size_t r = 0; r < indices.size(); r++){
+            const uint8_t *src = base + (size_t)indices[r] * cols;
+            double *dst = out.data() + r * cols;
+            #pragma omp simd
+            for(int j = 0; j < cols; j++)
+                dst[j] = src[j] * scale + shift;
+        }
+    }
+
+    Matrix ByteDataset::to_matrix() const{
+        Matrix res;
+        gather_rows(0, num_rows, res);
+        return res;
+    }
+
+    int ByteDataset::getRows() const{
+        return num_rows;
+    }
+
+    int ByteDataset::getCols() const{
+        return num_cols;
+    }
+
+    const uint8_t *ByteDataset::data() const{
+        return base;
+    }
+
+    size_t ByteDataset::bytes() const{
+        return storage ? storage->bytes() : 0;
+    }
+
+    bool ByteDataset::is_memory_mapped() const{
+        return storage && storage->mapping != nullptr;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#ifndef DATASET_H
+#define DATASET_H
+#include "matrix.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+namespace galanet {
+    // Raw uint8 samples, one row per sample, kept either in memory or mapped
+    // straight from an IDX file. Rows are converted to doubles (value * scale +
+    // shift) only when a batch is gathered, so the dataset costs one byte per
+    // value instead of eight. Copies and slices share the same storage.
+    class ByteDataset {
+        public:
+            ByteDataset();
+            ByteDataset(int num_rows, int num_cols, std::vector<uint8_t> bytes);
+            // Reads an IDX3 image file (magic 2051) as num_items x (rows * cols).
+            static ByteDataset load_idx_images(const std::string &path, bool memory_map = true);
+
+            ByteDataset slice(int start, int end) const;
+            void set_scaling(double scale, double shift = 0.0);
+            // Converts rows [start, end) into out, reusing its storage.
+            void gather_rows(int start, int end, Matrix &out) const;
+            void gather(const std::vector<int> &indices, Matrix &out) const;
+            Matrix to_matrix() const;
+
+            int getRows() const;
+            int getCols() const;
+            const uint8_t *data() const;
+            size_t bytes() const; //size of the shared storage
+            bool is_memory_mapped() const;
+        private:
+            struct Storage;
+            std::shared_ptr<const Storage> storage;
+            const uint8_t *base = nullptr;
+            int num_rows = 0;
+            int num_cols = 0;
+            double scale = 1.0;
+            double shift = 0.0;
+    };
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,396 @@
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <string>
+
+#include <arpa/inet.h>
+#include <csignal>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "distributed.h"
+#include "numa.h"
+
+namespace galanet::distributed {
+    // Layout of the shared segment: this header, then one chunk per rank for
+    // the inputs, then one chunk for the reduced result.
+    struct SharedRegion {
+        std::atomic<int> arrived;
+        std::atomic<int> generation;
+        int world_size;
+        size_t chunk_doubles;
+        size_t mapped_bytes;
+        double *slot(int rank) {
+            return reinterpret_cast<double *>(this + 1) + (size_t)rank * chunk_doubles;
+        }
+        double *result() {
+            return slot(world_size);
+        }
+    };
+
+    SharedRegion *SharedMemoryCommunicator::create_region(int world_size, size_t chunk_doubles){
+        if(world_size < 1 || chunk_doubles == 0) throw std::invalid_argument("Invalid shared memory region size");
+        size_t bytes = sizeof(SharedRegion) + (world_size + 1) * chunk_doubles * sizeof(double);
+        std::string name = "/galanet-" + std::to_string(getpid());
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        if(fd < 0) throw std::runtime_error("shm_open failed: " + std::string(strerror(errno)));
+        shm_unlink(name.c_str()); //the mapping stays valid and is inherited by forked workers
+        if(ftruncate(fd, bytes) != 0){
+            close(fd);
+            throw std::runtime_error("ftruncate failed: " + std::string(strerror(errno)));
+        }
+        void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if(mem == MAP_FAILED) throw std::runtime_error("mmap failed: " + std::string(strerror(errno)));
+        SharedRegion *region = new (mem) SharedRegion;
+        region->arrived.store(0);
+        region->generation.store(0);
+        region->world_size = world_size;
+        region->chunk_doubles = chunk_doubles;
+        region->mapped_bytes = bytes;
+        return region;
+    }
+
+    void SharedMemoryCommunicator::destroy_region(SharedRegion *region){
+        if(region != nullptr) munmap(region, region->mapped_bytes);
+    }
+
+    SharedMemoryCommunicator::SharedMemoryCommunicator(SharedRegion *region, int rank) : region(region), my_rank(rank) {
+        if(rank < 0 || rank >= region->world_size) throw std::invalid_argument("Rank out of range");
+    }
+
+    int SharedMemoryCommunicator::rank() const{
+        return my_rank;
+    }
+
+    int SharedMemoryCommunicator::size() const{
+        return region->world_size;
+    }
+
+    //sense-reversing barrier on the shared counters
+    void SharedMemoryCommunicator::barrier(){
+        int gen = region->generation.load(std::memory_order_acquire);
+        if(region->arrived.fetch_add(1, std::memory_order_acq_rel) == region->world_size - 1){
+            region->arrived.store(0, std::memory_order_relaxed);
+            region->generation.fetch_add(1, std::memory_order_release);
+            return;
+        }
+        for(int spins = 0; region->generation.load(std::memory_order_acquire) == gen; spins++)
+            if(spins > 1000) sched_yield();
+    }
+
+    void SharedMemoryCommunicator::allreduce_sum(double *data, size_t n){
+        const int world = region->world_size;
+        if(world == 1) return;
+        for(size_t offset = 0; offset < n; offset += region->chunk_doubles){
+            size_t m = std::min(region->chunk_doubles, n - offset);
+            std::copy(data + offset, data + offset + m, region->slot(my_rank));
+            barrier();
+            //each rank reduces its own slice, always summing ranks in the same order
+            size_t begin = m * my_rank / world;
+            size_t end = m * (my_rank + 1) / world;
+            double *result = region->result();
+            for(size_t i = begin; i < end; i++){
+                double s = region->slot(0)[i];
+                for(int r = 1; r < world; r++)
+                    s += region->slot(r)[i];
+                result[i] = s;
+            }
+            barrier();
+            std::copy(result, result + m, data + offset);
+            barrier(); //nobody may overwrite the slots before everyone has read the result
+        }
+    }
+
+    static void set_nodelay(int fd){
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+
+    TcpCommunicator::TcpCommunicator(int rank, int world_size, const std::vector<std::string> &hosts, int base_port)
+        : my_rank(rank), world_size(world_size) {
+        if(rank < 0 || rank >= world_size || (int)hosts.size() != world_size) throw std::invalid_argument("Invalid TCP communicator layout");
+        if(world_size == 1) return;
+
+        int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(listen_fd < 0) throw std::runtime_error("socket failed: " + std::string(strerror(errno)));
+        int one = 1;
+        setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(base_port + rank);
+        if(bind(listen_fd, (sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 1) != 0){
+            close(listen_fd);
+            throw std::runtime_error("Cannot listen on port " + std::to_string(base_port + rank) + ": " + strerror(errno));
+        }
+
+        int next = (rank + 1) % world_size;
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *res = nullptr;
+        if(getaddrinfo(hosts[next].c_str(), std::to_string(base_port + next).c_str(), &hints, &res) != 0){
+            close(listen_fd);
+            throw std::runtime_error("Cannot resolve host " + hosts[next]);
+        }
+        //the next rank may not be listening yet, keep retrying for a while
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+        while(true){
+            next_fd = socket(AF_INET, SOCK_STREAM, 0);
+            if(connect(next_fd, res->ai_addr, res->ai_addrlen) == 0) break;
+            close(next_fd);
+            next_fd = -1;
+            if(std::chrono::steady_clock::now() > deadline){
+                freeaddrinfo(res);
+                close(listen_fd);
+                throw std::runtime_error("Cannot connect to rank " + std::to_string(next));
+            }
+            usleep(10000);
+        }
+        freeaddrinfo(res);
+        prev_fd = accept(listen_fd, nullptr, nullptr);
+        close(listen_fd);
+        if(prev_fd < 0) throw std::runtime_error("accept failed: " + std::string(strerror(errno)));
+        set_nodelay(next_fd);
+        set_nodelay(prev_fd);
+        fcntl(next_fd, F_SETFL, fcntl(next_fd, F_GETFL) | O_NONBLOCK);
+        fcntl(prev_fd, F_SETFL, fcntl(prev_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+    TcpCommunicator::~TcpCommunicator(){
+        if(next_fd >= 0) close(next_fd);
+        if(prev_fd >= 0) close(prev_fd);
+    }
+
+    int TcpCommunicator::rank() const{
+        return my_rank;
+    }
+
+    int TcpCommunicator::size() const{
+        return world_size;
+    }
+
+    //sends send_n values to the next rank while receiving recv_n values from the previous one
+    void TcpCommunicator::exchange(const double *send, size_t send_n, double *recv, size_t recv_n){
+        const char *out = reinterpret_cast<const char *>(send);
+        char *in = reinterpret_cast<char *>(recv);
+        size_t send_total = send_n * sizeof(double), recv_total = recv_n * sizeof(double), sent = 0, received = 0;
+        while(sent < send_total || received < recv_total){
+            pollfd fds[2] = {{next_fd, short(sent < send_total ? POLLOUT : 0), 0}, {prev_fd, short(received < recv_total ? POLLIN : 0), 0}};
+            if(poll(fds, 2, -1) < 0){
+                if(errno == EINTR) continue;
+                throw std::runtime_error("poll failed: " + std::string(strerror(errno)));
+            }
+            if(sent < send_total && (fds[0].revents & (POLLOUT | POLLERR | POLLHUP))){
+                ssize_t k = ::send(next_fd, out + sent, send_total - sent, MSG_NOSIGNAL);
+                if(k < 0 && errno != EAGAIN && errno != EINTR) throw std::runtime_error("send failed: " + std::string(strerror(errno)));
+                if(k > 0) sent += k;
+            }
+            if(received < recv_total && (fds[1].revents & (POLLIN | POLLERR | POLLHUP))){
+                ssize_t k = ::recv(prev_fd, in + received, recv_total - received, 0);
+                if(k == 0) throw std::runtime_error("Peer closed the connection");
+                if(k < 0 && errno != EAGAIN && errno != EINTR) throw std::runtime_error("recv failed: " + std::string(strerror(errno)));
+                if(k > 0) received += k;
+            }
+        }
+    }
+
+    void TcpCommunicator::allreduce_sum(double *data, size_t n){
+        if(world_size == 1) return;
+        auto begin = [&](int c) { return n * c / world_size; };
+        auto length = [&](int c) { return begin(c + 1) - begin(c); };
+        auto wrap = [&](int c) { return ((c % world_size) + world_size) % world_size; };
+        scratch.resize(length(world_size - 1) + 1);
+        //reduce-scatter: after world_size-1 steps rank r owns the full sum of chunk r+1
+        for(int step = 0; step < world_size - 1; step++){
+            int send_chunk = wrap(my_rank - step);
+            int recv_chunk = wrap(my_rank - step - 1);
+            exchange(data + begin(send_chunk), length(send_chunk), scratch.data(), length(recv_chunk));
+            for(size_t i = 0; i < length(recv_chunk); i++)
+                data[begin(recv_chunk) + i] += scratch[i];
+        }
+        //all-gather the reduced chunks around the ring
+        for(int step = 0; step < world_size - 1; step++){
+            int send_chunk = wrap(my_rank - step + 1);
+            int recv_chunk = wrap(my_rank - step);
+            exchange(data + begin(send_chunk), length(send_chunk), data + begin(recv_chunk), length(recv_chunk));
+        }
+    }
+
+    int launch(int num_workers, const std::string &transport, const std::function<void(Communicator &)> &worker, int tcp_base_port){
+        if(num_workers < 1) throw std::invalid_argument("At least one worker is required");
+        if(transport != "shm" && transport != "tcp") throw std::invalid_argument("Invalid transport");
+        SharedRegion *region = nullptr;
+        if(transport == "shm")
+            region = SharedMemoryCommunicator::create_region(num_workers, 1 << 18);
+
+        //unflushed parent output would otherwise be written once more by every worker
+        std::cout.flush();
+        std::fflush(nullptr);
+        std::vector<pid_t> pids;
+        for(int rank = 0; rank < num_workers; rank++){
+            pid_t pid = fork();
+            if(pid < 0){
+                for(pid_t p : pids) kill(p, SIGTERM);
+                for(pid_t p : pids) waitpid(p, nullptr, 0);
+                SharedMemoryCommunicator::destroy_region(region);
+                throw std::runtime_error("fork failed: " + std::string(strerror(errno)));
+            }
+            if(pid == 0){
+                int status = 0;
+                try {
+                    //each worker gets a disjoint share of the machine (whole NUMA nodes when
+                    //possible) and an OpenMP team of matching size; forked children would
+                    //otherwise each start a team as wide as the whole machine
+                    std::vector<int> cpus = numa::partition_cpus(rank, num_workers);
+                    numa::bind_current_thread(cpus);
+                #ifdef _OPENMP
+                    omp_set_num_threads(cpus.size());
+                #endif
+                    if(region != nullptr){
+                        SharedMemoryCommunicator comm(region, rank);
+                        worker(comm);
+                    } else {
+                        TcpCommunicator comm(rank, num_workers, std::vector<std::string>(num_workers, "127.0.0.1"), tcp_base_port);
+                        worker(comm);
+                    }
+                } catch (const std::exception &e) {
+                    std::cerr << "Worker " << rank << " failed: " << e.what() << std::endl;
+                    status = 1;
+                }
+                std::cout.flush();
+                _exit(status);
+            }
+            pids.push_back(pid);
+        }
+
+        //a dead worker would leave the others waiting in a collective forever
+        int result = 0;
+        for(size_t remaining = pids.size(); remaining > 0; remaining--){
+            int status = 0;
+            pid_t pid = wait(&status);
+            if(pid < 0) break;
+            if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+                if(result == 0)
+                    for(pid_t p : pids)
+                        if(p != pid) kill(p, SIGTERM);
+                result = 1;
+            }
+        }
+        SharedMemoryCommunicator::destroy_region(region);
+        return result;
+    }
+
+    GradientReducer::GradientReducer(Communicator &comm, size_t bucket_bytes) : comm(comm), bucket_bytes(bucket_bytes) {
+        worker = std::thread(&GradientReducer::run, this);
+    }
+
+    GradientReducer::~GradientReducer(){
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        work_ready.notify_all();
+        worker.join();
+    }
+
+    void GradientReducer::prepare(const std::vector<size_t> &layer_sizes){
+        const int num_layers = layer_sizes.size();
+        layer_offset.assign(num_layers, 0);
+        bucket_of_layer.assign(num_layers, 0);
+        bucket_first_layer.clear();
+        bucket_begin.clear();
+        bucket_end.clear();
+        //backward produces the last layer first, so lay layers out in reverse; a bucket is
+        //closed before it would outgrow bucket_bytes, so a small last layer is sent on its
+        //own instead of waiting for a large first layer (a layer above the cap gets its own bucket)
+        size_t offset = 0;
+        for(int k = num_layers - 1; k >= 0; k--){
+            if(bucket_begin.empty() || (bucket_end.back() - bucket_begin.back() + layer_sizes[k]) * sizeof(double) > bucket_bytes){
+                bucket_begin.push_back(offset);
+                bucket_end.push_back(offset);
+                bucket_first_layer.push_back(k);
+            }
+            layer_offset[k] = offset;
+            offset += layer_sizes[k];
+            bucket_of_layer[k] = bucket_begin.size() - 1;
+            bucket_first_layer.back() = k;
+            bucket_end.back() = offset;
+        }
+        flat.assign(offset, 0.0);
+    }
+
+    double *GradientReducer::layer_buffer(int layer){
+        return flat.data() + layer_offset.at(layer);
+    }
+
+    void GradientReducer::mark_ready(int layer){
+        int bucket = bucket_of_layer.at(layer);
+        if(bucket_first_layer[bucket] != layer) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(bucket);
+            queued++;
+        }
+        work_ready.notify_one();
+    }
+
+    void GradientReducer::finish(){
+        std::unique_lock<std::mutex> lock(mutex);
+        work_done.wait(lock, [this] { return completed == queued; });
+        completed = 0;
+        queued = 0;
+        if(error){
+            std::exception_ptr failure = error;
+            error = nullptr;
+            std::rethrow_exception(failure);
+        }
+    }
+
+    void GradientReducer::run(){
+        while(true){
+            int bucket;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                work_ready.wait(lock, [this] { return stopping || !pending.empty(); });
+                if(pending.empty()) return;
+                bucket = pending.front();
+                pending.pop_front();
+            }
+            double *data = flat.data() + bucket_begin[bucket];
+            size_t n = bucket_end[bucket] - bucket_begin[bucket];
+            std::exception_ptr failure;
+            try {
+                comm.allreduce_sum(data, n);
+                const double scale = 1.0 / comm.size();
+                for(size_t i = 0; i < n; i++)
+                    data[i] *= scale;
+            } catch (...) {
+                failure = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if(failure && !error) error = failure;
+                completed++;
+            }
+            work_done.notify_all();
+        }
+    }
+}
\ No newline at end of file
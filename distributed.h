@@ -0,0 +1,106 @@
+#ifndef DISTRIBUTED_H
+#define DISTRIBUTED_H
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace galanet::distributed {
+    // Collective operations between the worker processes of one training job.
+    // Every rank must issue the same sequence of calls with the same sizes.
+    class Communicator {
+        public:
+            virtual ~Communicator() = default;
+            virtual int rank() const = 0;
+            virtual int size() const = 0;
+            // In-place element-wise sum; every rank ends up with bit-identical values.
+            virtual void allreduce_sum(double *data, size_t n) = 0;
+    };
+
+    struct SharedRegion;
+
+    // Reduce-scatter + all-gather through a POSIX shared memory segment mapped
+    // before fork(). Messages larger than the segment are sent in chunks.
+    class SharedMemoryCommunicator : public Communicator {
+        public:
+            static SharedRegion *create_region(int world_size, size_t chunk_doubles);
+            static void destroy_region(SharedRegion *region);
+            SharedMemoryCommunicator(SharedRegion *region, int rank);
+            int rank() const override;
+            int size() const override;
+            void allreduce_sum(double *data, size_t n) override;
+        private:
+            void barrier();
+            SharedRegion *region;
+            int my_rank;
+    };
+
+    // Ring all-reduce over TCP. Rank r listens on base_port + r and connects to
+    // rank (r + 1) % world_size at hosts[(r + 1) % world_size], so the same code
+    // runs across machines.
+    class TcpCommunicator : public Communicator {
+        public:
+            TcpCommunicator(int rank, int world_size, const std::vector<std::string> &hosts, int base_port);
+            ~TcpCommunicator() override;
+            int rank() const override;
+            int size() const override;
+            void allreduce_sum(double *data, size_t n) override;
+        private:
+            void exchange(const double *send, size_t send_n, double *recv, size_t recv_n);
+            int my_rank;
+            int world_size;
+            int next_fd = -1;
+            int prev_fd = -1;
+            std::vector<double> scratch;
+    };
+
+    // Forks num_workers processes and runs worker(comm) in each of them, with
+    // transport "shm" (POSIX shared memory) or "tcp" (localhost sockets).
+    // Call it before any OpenMP region has run in the parent. Rank r is bound to
+    // numa::partition_cpus(r, num_workers) (whole NUMA nodes when there are enough,
+    // otherwise an even share of the cores) and its OpenMP team is sized to match,
+    // so the workers together use each core once. Returns 0 when every worker
+    // exited cleanly; a failing worker terminates the others.
+    int launch(int num_workers, const std::string &transport, const std::function<void(Communicator &)> &worker, int tcp_base_port = 29500);
+
+    // Averages per-layer gradients across ranks in buckets on a background
+    // thread, so the last layers' gradients are exchanged while backward is
+    // still running through the first layers.
+    class GradientReducer {
+        public:
+            GradientReducer(Communicator &comm, size_t bucket_bytes);
+            ~GradientReducer();
+            // layer_sizes[k] is the number of gradient values of layer k.
+            void prepare(const std::vector<size_t> &layer_sizes);
+            double *layer_buffer(int layer);
+            // Layers must be marked from last to first, once per step.
+            void mark_ready(int layer);
+            // Blocks until every bucket of the step has been averaged.
+            void finish();
+        private:
+            void run();
+            Communicator &comm;
+            size_t bucket_bytes;
+            std::vector<double> flat;
+            std::vector<size_t> layer_offset;
+            std::vector<int> bucket_of_layer;
+            std::vector<int> bucket_first_layer;
+            std::vector<size_t> bucket_begin;
+            std::vector<size_t> bucket_end;
+            std::deque<int> pending;
+            int completed = 0;
+            int queued = 0;
+            bool stopping = false;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable work_ready;
+            std::condition_variable work_done;
+            std::thread worker;
+    };
+}
+#endif
\ No newline at end of file
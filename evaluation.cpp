@@ -0,0 +1,114 @@
+#include <stdexcept>
+#include <iostream>
+#include <iomanip>
+
+#include "evaluation.h"
+
+namespace galanet {
+    int64_t Evaluation::confusion_at(int true_class, int predicted_class) const{
+        if(true_class < 0 || true_class >= num_classes || predicted_class < 0 || predicted_class >= num_classes)
+            throw std::invalid_argument("Class index out of bounds");
+        return confusion[(size_t)true_class * num_classes + predicted_class];
+    }
+
+    double Evaluation::precision(int c) const{
+        int64_t predicted = 0;
+        for(int t = 0; t < num_classes; t++)
+            predicted += confusion_at(t, c);
+        return predicted == 0 ? 0.0 : (double)confusion_at(c, c) / predicted;
+    }
+
+    double Evaluation::recall(int c) const{
+        int64_t actual = 0;
+        for(int p = 0; p < num_classes; p++)
+            actual += confusion_at(c, p);
+        return actual == 0 ? 0.0 : (double)confusion_at(c, c) / actual;
+    }
+
+    void Evaluation::print() const{
+        std::cout << "Samples: " << samples << " - loss: " << loss << " - accuracy: " << accuracy
+                  << " - top-" << top_k << " accuracy: " << top_k_accuracy << "\n";
+        std::cout << "class  precision  recall  | confusion (rows: true, columns: predicted)\n";
+        for(int c = 0; c < num_classes; c++){
+            std::cout << std::setw(5) << c << std::fixed << std::setprecision(4)
+                      << std::setw(11) << precision(c) << std::setw(8) << recall(c) << "  |";
+            std::cout.unsetf(std::ios::floatfield);
+            std::cout << std::setprecision(6);
+            for(int p = 0; p < num_classes; p++)
+                std::cout << " " << std::setw(6) << confusion_at(c, p);
+            std::cout << "\n";
+        }
+    }
+
+    EvaluationAccumulator::EvaluationAccumulator(int num_classes, int top_k, SampleLoss sample_loss) : sample_loss(sample_loss) {
+        if(num_classes <= 0) throw std::invalid_argument("Evaluation needs at least one class");
+        if(top_k <= 0) throw std::invalid_argument("top_k must be positive");
+        totals.num_classes = num_classes;
+        totals.top_k = top_k;
+        totals.confusion.assign((size_t)num_classes * num_classes, 0);
+    }
+
+    void EvaluationAccumulator::add(const Matrix &predictions, const Matrix &targets, int first_row){
+        const int rows = predictions.getRows(), classes = totals.num_classes;
+        if(predictions.getCols() != classes || targets.getCols() != classes) throw std::invalid_argument("Shape mismatch");
+        if(first_row < 0 || first_row + rows > targets.getRows()) throw std::invalid_argument("Index out of bounds");
+        const double *P = predictions.data();
+        const double *T = targets.data() + (size_t)first_row * classes;
+        const int k = totals.top_k;
+        double loss = 0;
+        int64_t top1 = 0, topk = 0;
+        //every metric comes out of the same pass over a row; the confusion matrix is
+        //counted per thread and merged once per chunk
+        #pragma omp parallel reduction(+:loss, top1, topk)
+        {
+            std::vector<int64_t> confusion((size_t)classes * classes, 0);
+            #pragma omp for schedule(static)
+            for(int i = 0; i < rows; i++){
+                const double *p = P + (size_t)i * classes;
+                const double *t = T + (size_t)i * classes;
+                loss += sample_loss(p, t, classes);
+                int predicted = 0, actual = 0;
+                for(int j = 1; j < classes; j++){
+                    if(p[j] > p[predicted]) predicted = j;
+                    if(t[j] > t[actual]) actual = j;
+                }
+                //outputs ranked above the true class, ties going to the lower index like the argmax
+                int ahead = 0;
+                for(int j = 0; j < classes; j++)
+                    ahead += p[j] > p[actual] || (p[j] == p[actual] && j < actual);
+                top1 += predicted == actual;
+                topk += ahead < k;
+                confusion[(size_t)actual * classes + predicted]++;
+            }
+            #pragma omp critical
+            for(size_t c = 0; c < confusion.size(); c++)
+                totals.confusion[c] += confusion[c];
+        }
+        totals.samples += rows;
+        totals.loss += loss;
+        totals.accuracy += top1;
+        totals.top_k_accuracy += topk;
+    }
+
+    void EvaluationAccumulator::reduce(const std::function<void(double *data, size_t n)> &allreduce_sum){
+        //counts stay exact as doubles far beyond any dataset size
+        std::vector<double> sums{(double)totals.samples, totals.loss, totals.accuracy, totals.top_k_accuracy};
+        sums.insert(sums.end(), totals.confusion.begin(), totals.confusion.end());
+        allreduce_sum(sums.data(), sums.size());
+        totals.samples = (int64_t)sums[0];
+        totals.loss = sums[1];
+        totals.accuracy = sums[2];
+        totals.top_k_accuracy = sums[3];
+        for(size_t c = 0; c < totals.confusion.size(); c++)
+            totals.confusion[c] = (int64_t)sums[4 + c];
+    }
+
+    Evaluation EvaluationAccumulator::finish() const{
+        if(totals.samples == 0) throw std::invalid_argument("Cannot evaluate an empty dataset");
+        Evaluation res = totals;
+        res.loss /= res.samples;
+        res.accuracy /= res.samples;
+        res.top_k_accuracy /= res.samples;
+        return res;
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef EVALUATION_H
+#define EVALUATION_H
+#include "matrix.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+namespace galanet {
+    // Metrics of a classifier over a dataset. The true class of a sample is the
+    // argmax of its target row, the predicted class the argmax of its output.
+    struct Evaluation {
+        int num_classes = 0;
+        int top_k = 1;
+        int64_t samples = 0;
+        double loss = 0;            //mean over samples, as NN::calculate_loss
+        double accuracy = 0;        //top-1
+        double top_k_accuracy = 0;  //true class among the k highest outputs
+        std::vector<int64_t> confusion; //num_classes x num_classes, row = true class, column = predicted
+
+        int64_t confusion_at(int true_class, int predicted_class) const;
+        double precision(int c) const; //0 when class c was never predicted
+        double recall(int c) const;    //0 when class c never occurs
+        void print() const;
+    };
+
+    // Builds an Evaluation from chunks of predictions, so the predictions for a
+    // whole dataset never have to exist at once. Each chunk is reduced in a
+    // single parallel pass computing every metric together.
+    class EvaluationAccumulator {
+        public:
+            // Loss of one sample before averaging, e.g. loss::crossEntropySample.
+            using SampleLoss = double (*)(const double *predictions, const double *targets, int n);
+            EvaluationAccumulator(int num_classes, int top_k, SampleLoss sample_loss);
+            // Adds the predictions for rows [first_row, first_row + predictions.getRows()) of targets.
+            void add(const Matrix &predictions, const Matrix &targets, int first_row);
+            // Replaces the running totals by their sum over several accumulators, e.g.
+            // allreduce_sum of a Communicator when every rank evaluated its own shard.
+            void reduce(const std::function<void(double *data, size_t n)> &allreduce_sum);
+            Evaluation finish() const; //throws when no sample was added
+        private:
+            Evaluation totals; //loss and accuracies hold sums until finish()
+            SampleLoss sample_loss;
+    };
+}
+#endif
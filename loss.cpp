@@ -12,10 +12,23 @@ namespace galanet::loss {
     }
 
        Matrix meanSquaredErrorDerivative(const Matrix &predictions, const Matrix &targets) {
+        Matrix res;
+        meanSquaredErrorDerivative(predictions, targets, res);
+        return res;
+    }
+
+    void meanSquaredErrorDerivative(const Matrix &predictions, const Matrix &targets, Matrix &out) {
         if (predictions.getRows() != targets.getRows() || predictions.getCols() != targets.getCols()) {
             throw std::invalid_argument("targets and predictions must have the same shape");
         }
-        return (predictions - targets) / predictions.getRows();  // Removed the 2* due to 1/2n in loss
+        const double n = predictions.getRows();  // Removed the 2* due to 1/2n in loss
+        out.resize(predictions.getRows(), predictions.getCols());
+        const double *p = predictions.data(), *t = targets.data();
+        double *o = out.data();
+        const size_t size = (size_t)predictions.getRows() * predictions.getCols();
+        #pragma omp parallel for
+        for (size_t i = 0; i < size; i++)
+            o[i] = (p[i] - t[i]) / n;
     }
 
     // Mean Absolute Error (MAE)
@@ -27,11 +40,23 @@ namespace galanet::loss {
     }
 
     Matrix meanAbsoluteErrorDerivative(const Matrix &predictions, const Matrix &targets) {
+        Matrix res;
+        meanAbsoluteErrorDerivative(predictions, targets, res);
+        return res;
+    }
+
+    void meanAbsoluteErrorDerivative(const Matrix &predictions, const Matrix &targets, Matrix &out) {
         if (predictions.getRows() != targets.getRows() || predictions.getCols() != targets.getCols()) {
             throw std::invalid_argument("targets and predictions must have the same shape");
         }
-        Matrix diff = predictions - targets;
-        return diff.sign() / predictions.getRows();
+        const double n = predictions.getRows();
+        out.resize(predictions.getRows(), predictions.getCols());
+        const double *p = predictions.data(), *t = targets.data();
+        double *o = out.data();
+        const size_t size = (size_t)predictions.getRows() * predictions.getCols();
+        #pragma omp parallel for
+        for (size_t i = 0; i < size; i++)
+            o[i] = std::copysign(1.0, p[i] - t[i]) / n;
     }
 
     // Cross-Entropy Loss
@@ -55,10 +80,46 @@ namespace galanet::loss {
     }
 
     Matrix crossEntropyLossDerivative(const Matrix &predictions, const Matrix &targets) {
+        Matrix res;
+        crossEntropyLossDerivative(predictions, targets, res);
+        return res;
+    }
+
+    void crossEntropyLossDerivative(const Matrix &predictions, const Matrix &targets, Matrix &out) {
         //assume predicitons are outputs of softmax
         if (predictions.getRows() != targets.getRows() || predictions.getCols() != targets.getCols()) {
             throw std::invalid_argument("targets and predictions must have the same shape");
         }
-        return (predictions - targets) / predictions.getRows();
+        const double n = predictions.getRows();
+        out.resize(predictions.getRows(), predictions.getCols());
+        const double *p = predictions.data(), *t = targets.data();
+        double *o = out.data();
+        const size_t size = (size_t)predictions.getRows() * predictions.getCols();
+        #pragma omp parallel for
+        for (size_t i = 0; i < size; i++)
+            o[i] = (p[i] - t[i]) / n;
+    }
+
+    double meanSquaredErrorSample(const double *predictions, const double *targets, int n) {
+        double loss = 0.0;
+        for (int j = 0; j < n; j++)
+            loss += (predictions[j] - targets[j]) * (predictions[j] - targets[j]);
+        return loss / 2.0;
+    }
+
+    double meanAbsoluteErrorSample(const double *predictions, const double *targets, int n) {
+        double loss = 0.0;
+        for (int j = 0; j < n; j++)
+            loss += std::abs(predictions[j] - targets[j]);
+        return loss;
+    }
+
+    double crossEntropySample(const double *predictions, const double *targets, int n) {
+        double loss = 0.0;
+        for (int j = 0; j < n; j++) {
+            double pred = std::max(std::min(predictions[j], 1.0 - Matrix::EPSILON), Matrix::EPSILON);
+            loss -= targets[j] * std::log(pred);
+        }
+        return loss;
     }
-}
\ No newline at end of file
+}
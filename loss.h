@@ -8,5 +8,15 @@ namespace galanet::loss {
         Matrix meanAbsoluteErrorDerivative(const Matrix &predictions, const Matrix &targets);
         double crossEntropyLoss(const Matrix &predictions, const Matrix &targets);
         Matrix crossEntropyLossDerivative(const Matrix &predictions, const Matrix &targets);
+
+        // Same derivatives written into out, which is resized keeping its storage.
+        void meanSquaredErrorDerivative(const Matrix &predictions, const Matrix &targets, Matrix &out);
+        void meanAbsoluteErrorDerivative(const Matrix &predictions, const Matrix &targets, Matrix &out);
+        void crossEntropyLossDerivative(const Matrix &predictions, const Matrix &targets, Matrix &out);
+
+        // Loss of a single sample of n outputs; the batch losses above are the mean of these.
+        double meanSquaredErrorSample(const double *predictions, const double *targets, int n);
+        double meanAbsoluteErrorSample(const double *predictions, const double *targets, int n);
+        double crossEntropySample(const double *predictions, const double *targets, int n);
 }
 #endif
\ No newline at end of file
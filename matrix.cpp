@@ -2,12 +2,35 @@
 #include <cmath>
 #include <algorithm>
 #include "matrix.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace galanet{
 
+        //writes rows x cols values (copied from src, or val when src is null). With numa first touch
+        //on, large buffers are written by the OpenMP team with the kernels' static row partition,
+        //so each page lands on the node of the thread that later works on those rows
+        static void fill_rows(double *dst, const double *src, double val, size_t rows, size_t cols){
+            const size_t n = rows * cols;
+            if (!numa::first_touch() || n * sizeof(double) < numa::FIRST_TOUCH_MIN_BYTES) {
+                if (src != nullptr) std::copy(src, src + n, dst);
+                else std::fill(dst, dst + n, val);
+                return;
+            }
+            #pragma omp parallel for schedule(static)
+            for (size_t i = 0; i < rows; i++) {
+                double *row = dst + i * cols;
+                if (src != nullptr) std::copy(src + i * cols, src + (i + 1) * cols, row);
+                else std::fill(row, row + cols, val);
+            }
+        }
+
         Matrix::Matrix() : num_rows(0), num_cols(0), values(){};
-        Matrix::Matrix(int num_rows, int num_cols) : num_rows(num_rows), num_cols(num_cols), values(num_rows * num_cols, 0) {}
-        Matrix::Matrix(int num_rows, int num_cols, double val) : num_rows(num_rows), num_cols(num_cols), values(num_rows * num_cols, val) {}
+        Matrix::Matrix(int num_rows, int num_cols) : Matrix(num_rows, num_cols, 0.0) {}
+        Matrix::Matrix(int num_rows, int num_cols, double val) : num_rows(num_rows), num_cols(num_cols), values((size_t)num_rows * num_cols) {
+            fill_rows(values.data(), nullptr, val, num_rows, num_cols);
+        }
         //element-wise access
         double &Matrix::operator()(int i, int j) {
             if (i >= num_rows || j >= num_cols) throw std::invalid_argument("Index out of bounds");
@@ -21,14 +44,18 @@ namespace galanet{
 
         //copy constructor
         Matrix::Matrix(const Matrix &other)
-            : num_rows(other.num_rows), num_cols(other.num_cols), values(other.values) {}
+            : num_rows(other.num_rows), num_cols(other.num_cols), values(other.values.size()) {
+            fill_rows(values.data(), other.values.data(), 0.0, num_rows, num_cols);
+        }
 
         //copy assignment operator
         Matrix &Matrix::operator=(const Matrix &other) {
             if (this == &other) return *this; 
             num_rows = other.num_rows;
             num_cols = other.num_cols;
-            values = other.values;
+            if (values.capacity() < other.values.size()) values = decltype(values)(); //reallocate without copying the old contents
+            values.resize(other.values.size());
+            fill_rows(values.data(), other.values.data(), 0.0, num_rows, num_cols);
             return *this;
         }
 
@@ -155,15 +182,87 @@ namespace galanet{
         //multiplication(dot product)
         Matrix Matrix::operator*(const Matrix &m) const{
             if(num_cols!=m.num_rows)throw std::invalid_argument("Shape not compatible for matrix multiplication");
-            Matrix res(num_rows, m.num_cols,0);
-            for (size_t i = 0; i < num_rows; i++) {
-                for (size_t j = 0; j < m.num_cols; j++) 
-                    for (size_t k = 0; k < num_cols; k++) {
-                        res(i, j) += values[i * num_cols + k] * m(k, j);
+            Matrix res;
+            gemm(*this, false, m, false, res);
+            return res;
+        }
+        //general matrix multiply into an existing buffer
+        void Matrix::gemm(const Matrix &a, bool transpose_a, const Matrix &b, bool transpose_b, Matrix &out, double alpha, double beta){
+            const int M = transpose_a ? a.num_cols : a.num_rows;
+            const int K = transpose_a ? a.num_rows : a.num_cols;
+            const int N = transpose_b ? b.num_rows : b.num_cols;
+            using autotune::GemmOp;
+            const GemmOp op = transpose_a ? (transpose_b ? GemmOp::TT : GemmOp::TN) : (transpose_b ? GemmOp::NT : GemmOp::NN);
+            gemm(a, transpose_a, b, transpose_b, out, alpha, beta, autotune::gemm_config(op, M, N, K));
+        }
+        void Matrix::gemm(const Matrix &a, bool transpose_a, const Matrix &b, bool transpose_b, Matrix &out, double alpha, double beta, const autotune::GemmConfig &config){
+            const int M = transpose_a ? a.num_cols : a.num_rows;
+            const int K = transpose_a ? a.num_rows : a.num_cols;
+            const int N = transpose_b ? b.num_rows : b.num_cols;
+            if(K != (transpose_b ? b.num_cols : b.num_rows)) throw std::invalid_argument("Shape not compatible for matrix multiplication");
+            if(&out == &a || &out == &b) throw std::invalid_argument("gemm output must not alias an operand");
+            if(beta == 0.0) out.resize(M, N);
+            else if(out.num_rows != M || out.num_cols != N) throw std::invalid_argument("Shape not compatible for accumulation");
+
+            const double *A = a.values.data();
+            const double *B = b.values.data();
+            double *C = out.values.data();
+            const int lda = a.num_cols;
+            const int ldb = b.num_cols;
+            const int TM = std::max(1, config.tile_m);
+            const int TK = std::max(1, config.tile_k > 0 ? std::min(config.tile_k, K) : K);
+            const int TN = std::max(1, config.tile_n > 0 ? std::min(config.tile_n, N) : N);
+            int threads = config.threads;
+        #ifdef _OPENMP
+            if(threads <= 0 || threads > omp_get_max_threads()) threads = omp_get_max_threads(); //tuned counts never oversubscribe the caller's team
+        #endif
+            const int row_tiles = (M + TM - 1) / TM;
+            //blocking only regroups the loops: every element is still summed over k in
+            //ascending order, so all configurations match the naive triple loop bit for bit
+            #pragma omp parallel num_threads(threads) if(threads > 1)
+            {
+                std::vector<double> acc((size_t)TM * N);
+                #pragma omp for schedule(static)
+                for (int t = 0; t < row_tiles; t++) {
+                    const int i0 = t * TM, i1 = std::min(M, i0 + TM);
+                    std::fill(acc.begin(), acc.end(), 0.0);
+                    for (int k0 = 0; k0 < K; k0 += TK) {
+                        const int k1 = std::min(K, k0 + TK);
+                        for (int j0 = 0; j0 < N; j0 += TN) {
+                            const int j1 = std::min(N, j0 + TN);
+                            for (int i = i0; i < i1; i++) {
+                                double *arow = acc.data() + (size_t)(i - i0) * N;
+                                if (transpose_b) {
+                                    for (int j = j0; j < j1; j++) {
+                                        double s = arow[j];
+                                        const double *brow = B + (size_t)j * ldb;
+                                        for (int k = k0; k < k1; k++)
+                                            s += (transpose_a ? A[(size_t)k * lda + i] : A[(size_t)i * lda + k]) * brow[k];
+                                        arow[j] = s;
+                                    }
+                                } else {
+                                    for (int k = k0; k < k1; k++) {
+                                        const double aik = transpose_a ? A[(size_t)k * lda + i] : A[(size_t)i * lda + k];
+                                        const double *brow = B + (size_t)k * ldb;
+                                        for (int j = j0; j < j1; j++)
+                                            arow[j] += aik * brow[j];
+                                    }
+                                }
+                            }
+                        }
                     }
+                    for (int i = i0; i < i1; i++) {
+                        const double *arow = acc.data() + (size_t)(i - i0) * N;
+                        double *crow = C + (size_t)i * N;
+                        if (beta == 0.0 && alpha == 1.0)
+                            std::copy(arow, arow + N, crow);
+                        else if (beta == 0.0)
+                            for (int j = 0; j < N; j++) crow[j] = alpha * arow[j];
+                        else
+                            for (int j = 0; j < N; j++) crow[j] = alpha * arow[j] + beta * crow[j];
+                    }
+                }
             }
-
-            return res;
         }
         //subtraction
         Matrix Matrix::operator/(const Matrix &m) const{
@@ -184,6 +283,11 @@ namespace galanet{
                     res(i-start,j)=values[i*num_cols+j];
             return res;
         }
+        void Matrix::subset_rows(int start, int end, Matrix &out) const{
+            if(start<0 || end>num_rows || start>end) throw std::invalid_argument("Index out of bounds");
+            out.resize(end-start,num_cols);
+            std::copy(values.begin()+(size_t)start*num_cols, values.begin()+(size_t)end*num_cols, out.values.begin());
+        }
 
         //unary operations
         //transpose
@@ -247,8 +351,22 @@ namespace galanet{
         int Matrix::getCols() const {
             return num_cols;
         }
+        void Matrix::resize(int num_rows, int num_cols) {
+            const size_t old_size = values.size();
+            this->num_rows = num_rows;
+            this->num_cols = num_cols;
+            values.resize((size_t)num_rows * num_cols);
+            if (old_size == 0) fill_rows(values.data(), nullptr, 0.0, num_rows, num_cols);
+            else if (values.size() > old_size) std::fill(values.begin() + old_size, values.end(), 0.0);
+        }
+        double *Matrix::data() {
+            return values.data();
+        }
+        const double *Matrix::data() const {
+            return values.data();
+        }
         std::vector<double> Matrix::flatten() const {
-            return values;
+            return std::vector<double>(values.begin(), values.end());
         }
         //print
         void Matrix::print() const{
@@ -1,6 +1,8 @@
 #ifndef MATRIX_H
 #define MATRIX_H
 #include <vector>
+#include "autotune.h"
+#include "numa.h"
 
 namespace galanet {
     class Matrix {
@@ -39,6 +41,13 @@ namespace galanet {
             Matrix operator/(const Matrix &m) const;
 
             Matrix subset_rows(int start, int end) const;
+            void subset_rows(int start, int end, Matrix &out) const; //copy rows into an existing buffer
+
+            // out = alpha * op(a) * op(b) + beta * out, op() optionally transposing.
+            // out is resized (keeping its storage) when beta == 0 and must not alias a or b.
+            // The blocking and thread count come from the autotuner unless given explicitly.
+            static void gemm(const Matrix &a, bool transpose_a, const Matrix &b, bool transpose_b, Matrix &out, double alpha = 1.0, double beta = 0.0);
+            static void gemm(const Matrix &a, bool transpose_a, const Matrix &b, bool transpose_b, Matrix &out, double alpha, double beta, const autotune::GemmConfig &config);
 
             Matrix transpose() const;
             Matrix abs() const;
@@ -48,10 +57,13 @@ namespace galanet {
             double sum();
             int getCols() const;
             int getRows() const;
+            void resize(int num_rows, int num_cols); //reshape, reusing the allocated storage when it is large enough
+            double *data();
+            const double *data() const;
             std::vector<double> flatten() const;
             void print() const;
         private:
-            std::vector<double> values;
+            std::vector<double, numa::DefaultInitAllocator<double>> values; //pages are placed by the first write, see numa::set_first_touch
             int num_rows;
             int num_cols;
     };
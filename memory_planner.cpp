@@ -0,0 +1,88 @@
+#include <stdexcept>
+#include <algorithm>
+#include <map>
+
+#include "memory_planner.h"
+
+namespace galanet {
+    void MemoryPlanner::plan(const std::vector<int> &dims, const std::vector<bool> &needs_mask, int batch_size, int segment_length){
+        if(dims.size() < 2 || needs_mask.size() != dims.size() - 1) throw std::invalid_argument("Invalid network shape for memory planning");
+        if(segment_length < 0) throw std::invalid_argument("Checkpoint segment length must be non-negative");
+        this->dims = dims;
+        this->batch_size = batch_size;
+        this->segment = segment_length;
+        const int num_layers = dims.size() - 1;
+
+        //stored boundaries own a slot; interior boundaries share one slot per offset within a segment
+        slot_of.assign(num_layers + 1, -1);
+        std::vector<int> slot_width;
+        std::map<int, int> shared;
+        for(int k = 0; k <= num_layers; k++){
+            if(is_stored(k)){
+                slot_of[k] = slot_width.size();
+                slot_width.push_back(dims[k]);
+            } else {
+                auto it = shared.find(k % segment);
+                if(it == shared.end()){
+                    it = shared.emplace(k % segment, slot_width.size()).first;
+                    slot_width.push_back(0);
+                }
+                slot_of[k] = it->second;
+                slot_width[it->second] = std::max(slot_width[it->second], dims[k]);
+            }
+        }
+        //reserve with the batch x width shape the kernels use, so that with numa first
+        //touch every thread places the rows it will later work on
+        planned_bytes = 0;
+        slots.assign(slot_width.size(), Matrix());
+        for(size_t s = 0; s < slots.size(); s++){
+            slots[s].resize(batch_size, slot_width[s]);
+            slots[s].resize(0, slot_width[s]);
+            planned_bytes += (size_t)batch_size * slot_width[s] * sizeof(double);
+        }
+
+        masks.assign(num_layers, BitMask());
+        for(int k = 0; k < num_layers; k++)
+            if(needs_mask[k]){
+                masks[k].resize((size_t)batch_size * dims[k + 1]);
+                planned_bytes += masks[k].bytes();
+            }
+
+        //gradients only flow through boundaries 1..num_layers, alternating between two buffers
+        int widest = *std::max_element(dims.begin() + 1, dims.end());
+        for(Matrix &g : grads){
+            g.resize(batch_size, widest);
+            g.resize(0, widest);
+            planned_bytes += (size_t)batch_size * widest * sizeof(double);
+        }
+    }
+
+    bool MemoryPlanner::matches(const std::vector<int> &dims, int batch_size, int segment_length) const{
+        return this->dims == dims && this->batch_size == batch_size && this->segment == segment_length;
+    }
+
+    Matrix &MemoryPlanner::activation(int k){
+        return slots[slot_of.at(k)];
+    }
+
+    BitMask &MemoryPlanner::mask(int layer){
+        return masks.at(layer);
+    }
+
+    Matrix &MemoryPlanner::grad(int parity){
+        return grads[parity & 1];
+    }
+
+    bool MemoryPlanner::is_stored(int k) const{
+        int num_layers = dims.size() - 1;
+        return segment == 0 || k % segment == 0 || k == num_layers;
+    }
+
+    int MemoryPlanner::segment_length() const{
+        return segment == 0 ? dims.size() - 1 : segment;
+    }
+
+    size_t MemoryPlanner::bytes() const{
+        return planned_bytes;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#ifndef MEMORY_PLANNER_H
+#define MEMORY_PLANNER_H
+#include "matrix.h"
+#include "bitmask.h"
+
+#include <vector>
+namespace galanet {
+    // Owns every activation and gradient buffer used by NN::train and assigns
+    // them to layer boundaries once per (topology, batch size). Boundary k holds
+    // the input of layer k, which is also the output of layer k-1, so nothing is
+    // copied between layers. With checkpointing every segment_length-th boundary
+    // is kept; the boundaries inside a segment share one set of slots and are
+    // recomputed during backward.
+    class MemoryPlanner {
+        public:
+            // dims[k] is the width of boundary k (dims.size() == num_layers + 1);
+            // needs_mask[k] tells whether layer k keeps a ReLU sign mask.
+            void plan(const std::vector<int> &dims, const std::vector<bool> &needs_mask, int batch_size, int segment_length);
+            bool matches(const std::vector<int> &dims, int batch_size, int segment_length) const;
+
+            Matrix &activation(int k);
+            BitMask &mask(int layer);
+            Matrix &grad(int parity);
+            bool is_stored(int k) const;
+            int segment_length() const;
+            size_t bytes() const;
+        private:
+            std::vector<int> dims;
+            int batch_size = 0;
+            int segment = 0;
+            std::vector<int> slot_of;
+            std::vector<Matrix> slots;
+            std::vector<BitMask> masks;
+            Matrix grads[2];
+            size_t planned_bytes = 0;
+    };
+}
+#endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include <iostream>
+#include <iomanip>
 #include <fstream>
 #include <string>
 #include <memory>
@@ -6,44 +7,23 @@
 #include <numeric>
 #include <random>
 #include <ctime>
+#include <chrono>
+#include <functional>
+#include <vector>
 
 
 #include "matrix.h"
+#include "dataset.h"
 #include "neural_network.h" 
+#include "distributed.h"
+#include "rng.h"
+#include "sweep.h"
+#include "autotune.h"
+#include "numa.h"
+#include "activation.h"
+#include "static_network.h"
 using namespace galanet;
 
-galanet::Matrix mnistImagesToMatrix(const std::string &path) {
-    std::ifstream file (path, std::ios::binary);
-    if (!file.is_open()) {
-        std::cerr << "Error opening file: " << path << std::endl;
-        exit(1);
-    }
-    int magic = 0;
-    int num_items = 0;
-    int num_rows = 0;
-    int num_cols = 0;
-    file.read((char*)&magic, sizeof(magic));
-    magic = __builtin_bswap32(magic);
-    if(magic!=2051)
-        throw std::invalid_argument("Invalid MNIST file (magic number)"); 
-    
-    file.read((char*)&num_items, sizeof(num_items));
-    num_items = __builtin_bswap32(num_items);
-    file.read((char*)&num_rows, sizeof(num_rows));
-    num_rows = __builtin_bswap32(num_rows);
-    file.read((char*)&num_cols, sizeof(num_cols));
-    num_cols = __builtin_bswap32(num_cols);
-    galanet::Matrix res(num_items, num_rows * num_cols);
-    for (int i = 0; i < num_items; i++) {
-        for (int j = 0; j < num_rows * num_cols; j++) {
-            unsigned char pixel = 0;
-            file.read((char*)&pixel, sizeof(pixel));
-            res(i, j) = pixel;
-        }
-    }
-    return res;
-}
-
 galanet::Matrix mnistLabelsToMatrix(const std::string &path) {
     std::ifstream file (path, std::ios::binary);
     if (!file.is_open()) {
@@ -66,18 +46,9 @@ galanet::Matrix mnistLabelsToMatrix(const std::string &path) {
     }
     return res;
 }
-int main(){
-    try {
-    srand(84);//set seed
-    //load training Data
-    Matrix training_set = mnistImagesToMatrix("./mnist_data/train-images.idx3-ubyte");
-    std::cout << "Training set shape: " << training_set.getRows() << "x" << training_set.getCols() << "\n";
-    training_set=training_set/255.0;
-    Matrix labels = mnistLabelsToMatrix("./mnist_data/train-labels.idx1-ubyte"); 
-    std::cout << "Labels shape: " << labels.getRows() << "x" << labels.getCols() << "\n";
-    //load test Data
-    Matrix test_set = mnistImagesToMatrix("./mnist_data/t10k-images.idx3-ubyte"); 
-    Matrix test_labels= mnistLabelsToMatrix("./mnist_data/t10k-labels.idx1-ubyte"); 
+//compile-time copy of the network built below, for single-sample inference; ~800KB of weights, so static storage
+static StaticNN<StaticDense<784, 128, ReLU>, StaticDense<128, 10, Softmax>> static_network;
+NN buildNetwork(){
     double learning_rate=0.0001;
     NN  nn=NN("cross_entropy"); //create neural network;
 
@@ -86,13 +57,109 @@ int main(){
     nn.add_layer(std::make_unique<DenseLayer>(layer1));
     nn.add_layer(std::make_unique<DenseLayer>(layer2));
     std::cout<<"created\n";
-    nn.train(training_set, labels, training_set, labels, 20, 64); // Train neural network
+    return nn;
+}
+// Effective bandwidth (GB/s) of the memory-bound Matrix kernels on buffers far larger
+// than the caches, allocated after the placement mode is set. Best of a few runs.
+std::vector<double> benchBandwidthKernels(){
+    const int rows = 4096, cols = 2048;
+    const double gb = (double)rows * cols * sizeof(double) / 1e9;
+    auto best_of = [](const std::function<void()> &kernel) {
+        double best = 1e30;
+        for (int r = 0; r < 5; r++) {
+            auto start = std::chrono::steady_clock::now();
+            kernel();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    };
+    Matrix a(rows, cols, 1.5), b(rows, cols, -0.5), c;
+    volatile double sink = 0;
+    std::vector<double> res;
+    res.push_back(1 * gb / best_of([&] { Matrix fresh(rows, cols, 2.0); sink = fresh(rows - 1, cols - 1); }));
+    res.push_back(3 * gb / best_of([&] { c = a + b; }));
+    res.push_back(3 * gb / best_of([&] { c = a - b; }));
+    res.push_back(2 * gb / best_of([&] { c = a.abs(); }));
+    res.push_back(1 * gb / best_of([&] { sink = a.sum(); }));
+    res.push_back(2 * gb / best_of([&] { c = a; activation::reluInPlace(c, nullptr); }));
+    return res;
+}
+void runNumaBenchmark(){
+    const char *names[] = {"alloc+fill", "add", "sub", "abs", "sum", "copy+relu"};
+    std::cout << "NUMA nodes: " << numa::num_nodes() << "\n";
+    std::vector<double> before = benchBandwidthKernels();
+    numa::pin_threads();
+    numa::set_first_touch(true);
+    std::vector<double> after = benchBandwidthKernels();
+    numa::set_first_touch(false);
+    numa::unpin_threads();
+    std::cout << "kernel        default GB/s   pinned+first-touch GB/s\n";
+    for (size_t k = 0; k < before.size(); k++)
+        std::cout << std::left << std::setw(12) << names[k] << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(14) << before[k] << std::setw(26) << after[k] << "\n";
+}
+// Usage: mnist [num_workers] [shm|tcp] | mnist sweep | mnist bench. More than one worker trains
+// data-parallel in forked processes that each take a shard of the training set;
+// "sweep" tunes hyperparameters with concurrent trials on the loaded dataset;
+// "bench" compares memory-bound kernels with and without NUMA-aware placement.
+int main(int argc, char **argv){
+    try {
+    if (argc > 1 && std::string(argv[1]) == "bench") {
+        runNumaBenchmark();
+        return 0;
+    }
+    galanet::rng::set_seed(84);//set seed
+    galanet::autotune::enable("galanet_tuning.cache");//tune GEMM shapes on first use, cached per CPU
+    int num_workers = argc > 1 ? std::atoi(argv[1]) : 1;
+    std::string transport = argc > 2 ? argv[2] : "shm";
+    //load training Data; pixels stay uint8 (memory-mapped) and are scaled per batch
+    ByteDataset training_set = ByteDataset::load_idx_images("./mnist_data/train-images.idx3-ubyte");
+    std::cout << "Training set shape: " << training_set.getRows() << "x" << training_set.getCols() << "\n";
+    training_set.set_scaling(1.0/255.0);
+    Matrix labels = mnistLabelsToMatrix("./mnist_data/train-labels.idx1-ubyte"); 
+    std::cout << "Labels shape: " << labels.getRows() << "x" << labels.getCols() << "\n";
+    //load test Data
+    ByteDataset test_set = ByteDataset::load_idx_images("./mnist_data/t10k-images.idx3-ubyte"); 
+    test_set.set_scaling(1.0/255.0);
+    Matrix test_labels= mnistLabelsToMatrix("./mnist_data/t10k-labels.idx1-ubyte"); 
+    if (argc > 1 && std::string(argv[1]) == "sweep") {
+        //hold out the last 10k training images for validation
+        ByteDataset train_x = training_set.slice(0, 50000), val_x = training_set.slice(50000, 60000);
+        Matrix train_y = labels.subset_rows(0, 50000), val_y = labels.subset_rows(50000, 60000);
+        std::vector<galanet::sweep::TrialConfig> configs = galanet::sweep::grid(
+            {0.0001, 0.0005, 0.001}, {32, 64, 128}, {{128}, {256}, {128, 64}}, 10, 3);
+        std::vector<galanet::sweep::TrialResult> results = galanet::sweep::run(configs, train_x, train_y, val_x, val_y);
+        galanet::sweep::write_results(results, "sweep_results.csv");
+        const galanet::sweep::TrialResult &best = results.front();
+        std::cout << "Best: lr " << best.config.learning_rate << " batch " << best.config.batch_size
+                  << " val_loss " << best.best_val_loss << " val_accuracy " << best.val_accuracy
+                  << " (" << results.size() << " trials in sweep_results.csv)" << std::endl;
+        return 0;
+    }
+    if (num_workers <= 1) {
+        NN nn = buildNetwork();
+        nn.train(training_set, labels, training_set, labels, 20, 64); // Train neural network
 
-    Matrix test_pred=nn.predict(test_set);
-    std::cout << "Test Accuracy: " << nn.calc_accuracy(test_pred,test_labels) << std::endl;
+        Evaluation test_eval=nn.evaluate(test_set,test_labels,3);
+        std::cout << "Test Accuracy: " << test_eval.accuracy << std::endl;
+        test_eval.print();
+        static_network.import_from(nn);
+        Matrix static_pred = static_network.predict(test_set.to_matrix());
+        std::cout << "Static network test accuracy: " << nn.calc_accuracy(static_pred,test_labels) << std::endl;
+        return 0;
+    }
+    //the datasets are shared copy-on-write with the forked workers; the network is built
+    //inside each worker because OpenMP must not have run in the parent before fork()
+    return galanet::distributed::launch(num_workers, transport, [&](galanet::distributed::Communicator &comm) {
+        NN nn = buildNetwork();
+        nn.set_communicator(&comm);
+        nn.train(training_set, labels, training_set, labels, 20, 64);
+        if (comm.rank() == 0) {
+            std::cout << "Test Accuracy: " << nn.evaluate(test_set,test_labels,1).accuracy << std::endl;
+        }
+    });
      } catch (const std::exception &e) {
         std::cerr << "Error: " << e.what() << std::endl;
         return 1;
     }
-    return 0;
 }
\ No newline at end of file
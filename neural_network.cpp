@@ -1,6 +1,8 @@
 #include <stdexcept>
 #include <iostream>
 #include <limits>
+#include <cmath>
+#include <algorithm>
 
 #include "neural_network.h"
 #include "weights_initializer.h"
@@ -32,47 +34,134 @@ namespace galanet{
     }
     Matrix DenseLayer::forward(const Matrix &inputs)
     {
-        last_inputs = inputs;
-        pre_activation = inputs * weights;
-        for (int i = 0; i < pre_activation.getRows(); i++)
-            for (int j = 0; j < pre_activation.getCols(); j++)
-                pre_activation(i, j) += this->bias(0, j);
+        Matrix outputs;
+        infer(inputs, outputs);
+        return outputs;
+    }
+    void DenseLayer::infer(const Matrix &inputs, Matrix &outputs)
+    {
+        if (weight_replicas.empty()) {
+            forward(inputs, outputs, nullptr, weights, bias);
+        } else {
+            const int node = numa::current_node();
+            forward(inputs, outputs, nullptr, weight_replicas[node], bias_replicas[node]);
+        }
+    }
+    void DenseLayer::forward(const Matrix &inputs, Matrix &outputs, BitMask *mask)
+    {
+        forward(inputs, outputs, mask, weights, bias);
+    }
+    void DenseLayer::forward(const Matrix &inputs, Matrix &outputs, BitMask *mask, const Matrix &weights, const Matrix &bias)
+    {
+        Matrix::gemm(inputs, false, weights, false, outputs);
+        double *z = outputs.data();
+        for (int i = 0; i < outputs.getRows(); i++)
+            for (int j = 0; j < outputs.getCols(); j++)
+                z[i * out_dim + j] += bias(0, j);
         if (this->activation_name == "relu")
-            return galanet::activation::relu(pre_activation);
+            galanet::activation::reluInPlace(outputs, mask);
         else if (this->activation_name == "tanh")
-            return galanet::activation::tanh(pre_activation);
+            galanet::activation::tanhInPlace(outputs);
         else if (this->activation_name == "softmax")
-            return galanet::activation::softmax(pre_activation);
+            galanet::activation::softmaxInPlace(outputs);
         else throw std::invalid_argument("Invalid activation function");    
     }
-    Matrix DenseLayer::backward(Matrix &grad){
-        Matrix gradActivation;
+    void DenseLayer::backward(const Matrix &inputs, const Matrix &outputs, const BitMask &mask, Matrix &grad, Matrix *input_grad, bool store_gradients){
         if (this->activation_name == "relu")
-            gradActivation =  galanet::activation::reluDerivative(pre_activation);
+            galanet::activation::reluBackward(grad, mask);
         else if (this->activation_name == "tanh")
-            gradActivation =  galanet::activation::tanhDerivative(pre_activation);
+            galanet::activation::tanhBackward(grad, outputs);
         else if (this->activation_name == "softmax")
-            gradActivation= galanet::activation::softmaxDerivative(pre_activation);
+            galanet::activation::softmaxBackward(grad, outputs);
         else throw std::invalid_argument("Invalid activation function");
 
+        if (input_grad != nullptr)
+            Matrix::gemm(grad, false, weights, true, *input_grad);  //calculate input gradient before weight update
 
-        for(int i=0;i<grad.getRows();i++)
-            for(int j=0;j<grad.getCols();j++)
-                grad(i,j)*=gradActivation(i,j);
-
-        Matrix input_grad = grad * weights.transpose();  //calculate input gradient before weight update
-
-
-        Matrix weights_grad=last_inputs.transpose()*grad;
-        Matrix bias_grad=Matrix(1,grad.getCols(),0);
-
-        for(int i=0;i<grad.getRows();i++)
-            for(int j=0;j<grad.getCols();j++)
-                bias_grad(0,j)+=grad(i,j);
-        weights= weights-weights_grad*learning_rate;
-        bias= bias - bias_grad*learning_rate;
-       
-        return input_grad;
+        const double *g = grad.data();
+        if (!store_gradients) {
+            Matrix::gemm(inputs, true, grad, false, weights, -learning_rate, 1.0);  //weights -= lr * inputs^T * grad
+            for (int j = 0; j < out_dim; j++) {
+                double s = 0;
+                for (int i = 0; i < grad.getRows(); i++)
+                    s += g[i * out_dim + j];
+                bias(0, j) = bias(0, j) - s * learning_rate;
+            }
+            drop_weight_replicas();
+            return;
+        }
+        Matrix::gemm(inputs, true, grad, false, weights_grad);
+        bias_grad.resize(1, out_dim);
+        for (int j = 0; j < out_dim; j++) {
+            double s = 0;
+            for (int i = 0; i < grad.getRows(); i++)
+                s += g[i * out_dim + j];
+            bias_grad(0, j) = s;
+        }
+    }
+    void DenseLayer::apply_gradients()
+    {
+        double *w = weights.data();
+        const double *wg = weights_grad.data();
+        const size_t n = (size_t)in_dim * out_dim;
+        #pragma omp parallel for
+        for (size_t i = 0; i < n; i++)
+            w[i] = w[i] - wg[i] * learning_rate;
+        for (int j = 0; j < out_dim; j++)
+            bias(0, j) = bias(0, j) - bias_grad(0, j) * learning_rate;
+        drop_weight_replicas();
+    }
+    void DenseLayer::replicate_weights()
+    {
+        const int nodes = numa::num_nodes();
+        weight_replicas.assign(nodes, Matrix());
+        bias_replicas.assign(nodes, Matrix());
+        for (int node = 0; node < nodes; node++)
+            numa::run_on_node(node, [&] {
+                weight_replicas[node] = weights;
+                bias_replicas[node] = bias;
+            });
+    }
+    void DenseLayer::drop_weight_replicas()
+    {
+        weight_replicas.clear();
+        bias_replicas.clear();
+    }
+    bool DenseLayer::has_weight_replicas() const
+    {
+        return !weight_replicas.empty();
+    }
+    int DenseLayer::getInDim() const
+    {
+        return in_dim;
+    }
+    int DenseLayer::getOutDim() const
+    {
+        return out_dim;
+    }
+    Matrix &DenseLayer::getWeights()
+    {
+        return weights;
+    }
+    Matrix &DenseLayer::getBias()
+    {
+        return bias;
+    }
+    Matrix &DenseLayer::getWeightsGrad()
+    {
+        return weights_grad;
+    }
+    Matrix &DenseLayer::getBiasGrad()
+    {
+        return bias_grad;
+    }
+    const std::string &DenseLayer::getActivationName() const
+    {
+        return activation_name;
+    }
+    bool DenseLayer::needsMask() const
+    {
+        return activation_name == "relu";
     }
 
 
@@ -87,41 +176,215 @@ namespace galanet{
     {
         this->layers.push_back(std::move(layer));
     }
+    int NN::num_layers() const
+    {
+        return this->layers.size();
+    }
+    DenseLayer &NN::getLayer(int index)
+    {
+        if (index < 0 || index >= (int)this->layers.size()) throw std::invalid_argument("Layer index out of bounds");
+        return *this->layers[index];
+    }
 
     Matrix NN::predict(const Matrix &features){
         Matrix res=features;
-        for(int i=0;i<this->layers.size();i++){
-            res=this->layers[i]->forward(res);
+        on_local_node([&] {
+            for(int i=0;i<this->layers.size();i++){
+                res=this->layers[i]->forward(res);
+            }
+        });
+        return res;
+    }
+
+    Matrix NN::predict(const ByteDataset &features, int chunk_rows){
+        if(this->layers.empty()) throw std::invalid_argument("Network has no layers");
+        Matrix res(features.getRows(), this->layers.back()->getOutDim());
+        Matrix chunk;
+        for(int start=0;start<features.getRows();start+=chunk_rows){
+            int end=std::min(start+chunk_rows,features.getRows());
+            features.gather_rows(start,end,chunk);
+            Matrix out=predict(chunk);
+            std::copy(out.data(), out.data() + (size_t)out.getRows() * out.getCols(), res.data() + (size_t)start * res.getCols());
         }
         return res;
     }
 
+    void NN::enable_checkpointing(int segment_length){
+        if(segment_length < 0) throw std::invalid_argument("Checkpoint segment length must be non-negative");
+        this->checkpointing = true;
+        this->checkpoint_segment = segment_length;
+    }
+    void NN::disable_checkpointing(){
+        this->checkpointing = false;
+    }
+    size_t NN::activation_memory_bytes() const{
+        return planner.bytes();
+    }
+    void NN::replicate_weights(){
+        for(auto &layer : this->layers)
+            layer->replicate_weights();
+    }
+    void NN::on_local_node(const std::function<void()> &fn){
+        if(this->layers.empty() || !this->layers.front()->has_weight_replicas()){
+            fn();
+            return;
+        }
+        //infer picks the replica of the thread calling gemm, but the GEMM team would span
+        //every node; a team bound to the caller's node makes all of its reads local
+        const int node = numa::current_node();
+        numa::run_on_node(node, fn, numa::node_cpus(node).size());
+    }
+
+    // Forward and backward over the batch already placed in planner.activation(0).
+    double NN::train_step(const Matrix &batch_targets){
+        const int num_layers = this->layers.size();
+        for(int k = 0; k < num_layers; k++)
+            this->layers[k]->forward(planner.activation(k), planner.activation(k + 1), &planner.mask(k));
+
+        Matrix &pred = planner.activation(num_layers);
+        double batch_loss = calculate_loss(pred, batch_targets);
+        int parity = 0;
+        calculate_loss_derivative(pred, batch_targets, planner.grad(parity)); //in place, keeping the planned storage
+
+        const int segment = planner.segment_length();
+        for(int seg_start = ((num_layers - 1) / segment) * segment; seg_start >= 0; seg_start -= segment){
+            int seg_end = std::min(seg_start + segment, num_layers);
+            //recompute the activations inside the segment that forward did not keep
+            for(int k = seg_start; k < seg_end - 1; k++)
+                if(!planner.is_stored(k + 1))
+                    this->layers[k]->forward(planner.activation(k), planner.activation(k + 1), nullptr);
+            for(int k = seg_end - 1; k >= seg_start; k--){
+                Matrix *input_grad = k > 0 ? &planner.grad(parity + 1) : nullptr;
+                this->layers[k]->backward(planner.activation(k), planner.activation(k + 1), planner.mask(k), planner.grad(parity), input_grad, reducer != nullptr);
+                parity++;
+                if(reducer){
+                    //hand the gradients over so their bucket can be reduced while backward continues
+                    Matrix &wg = this->layers[k]->getWeightsGrad();
+                    Matrix &bg = this->layers[k]->getBiasGrad();
+                    double *buffer = reducer->layer_buffer(k);
+                    std::copy(wg.data(), wg.data() + (size_t)wg.getRows() * wg.getCols(), buffer);
+                    std::copy(bg.data(), bg.data() + bg.getCols(), buffer + (size_t)wg.getRows() * wg.getCols());
+                    reducer->mark_ready(k);
+                }
+            }
+        }
+        if(reducer){
+            reducer->finish();
+            for(int k = 0; k < num_layers; k++){
+                Matrix &wg = this->layers[k]->getWeightsGrad();
+                Matrix &bg = this->layers[k]->getBiasGrad();
+                const double *buffer = reducer->layer_buffer(k);
+                size_t n = (size_t)wg.getRows() * wg.getCols();
+                std::copy(buffer, buffer + n, wg.data());
+                std::copy(buffer + n, buffer + n + bg.getCols(), bg.data());
+                this->layers[k]->apply_gradients();
+            }
+        }
+        return batch_loss;
+    }
+
+    void NN::set_communicator(distributed::Communicator *comm, size_t bucket_bytes){
+        this->reducer.reset();
+        this->comm = comm;
+        if(comm != nullptr && comm->size() > 1)
+            this->reducer = std::make_unique<distributed::GradientReducer>(*comm, bucket_bytes);
+    }
+
+    void NN::set_verbose(bool verbose){
+        this->verbose = verbose;
+    }
+
+    void NN::set_epoch_callback(std::function<bool(int epoch, double val_loss)> callback){
+        this->epoch_callback = std::move(callback);
+    }
+
+    // Every rank starts from rank 0's weights: the others contribute zeros to a sum.
+    void NN::sync_parameters(){
+        for(auto &layer : this->layers){
+            for(Matrix *m : {&layer->getWeights(), &layer->getBias()}){
+                size_t n = (size_t)m->getRows() * m->getCols();
+                if(comm->rank() != 0) m->fill(0);
+                comm->allreduce_sum(m->data(), n);
+            }
+        }
+    }
+
     void NN::train(const Matrix &features, const Matrix &targets, const Matrix &val_features , const Matrix &val_targets , int epochs, int batchSize, int patience ){
+        train_rows([&](int start, int end, Matrix &out) { features.subset_rows(start, end, out); }, features.getRows(), targets,
+                   [&](int start, int end, Matrix &out) { val_features.subset_rows(start, end, out); }, val_features.getRows(), val_targets, epochs, batchSize, patience);
+    }
+
+    void NN::train(const ByteDataset &features, const Matrix &targets, const ByteDataset &val_features, const Matrix &val_targets, int epochs, int batchSize, int patience){
+        train_rows([&](int start, int end, Matrix &out) { features.gather_rows(start, end, out); }, features.getRows(), targets,
+                   [&](int start, int end, Matrix &out) { val_features.gather_rows(start, end, out); }, val_features.getRows(), val_targets, epochs, batchSize, patience);
+    }
+
+    void NN::train_rows(const RowLoader &load_rows, int num_rows, const Matrix &targets, const RowLoader &load_val, int num_val_rows, const Matrix &val_targets, int epochs, int batchSize, int patience){
+        const int num_layers = this->layers.size();
+        if(num_layers == 0) throw std::invalid_argument("Network has no layers");
+        if(num_val_rows == 0) throw std::invalid_argument("Validation set is empty"); //early stopping needs it
+        if(num_val_rows != val_targets.getRows()) throw std::invalid_argument("Shape mismatch");
+        std::vector<int> dims{this->layers[0]->getInDim()};
+        std::vector<bool> needs_mask;
+        for(auto &layer : this->layers){
+            dims.push_back(layer->getOutDim());
+            needs_mask.push_back(layer->needsMask());
+        }
+        int segment = 0;
+        if(this->checkpointing)
+            segment = this->checkpoint_segment > 0 ? this->checkpoint_segment : (int)std::ceil(std::sqrt((double)num_layers));
+        if(!planner.matches(dims, batchSize, segment))
+            planner.plan(dims, needs_mask, batchSize, segment);
+
+        int row_begin = 0, row_count = num_rows;
+        bool verbose = this->verbose;
+        if(reducer){
+            //equal shard sizes keep every rank on the same number of steps
+            row_count = num_rows / comm->size();
+            row_begin = comm->rank() * row_count;
+            std::vector<size_t> layer_sizes;
+            for(auto &layer : this->layers)
+                layer_sizes.push_back((size_t)(layer->getInDim() + 1) * layer->getOutDim());
+            reducer->prepare(layer_sizes);
+            sync_parameters();
+            verbose = verbose && comm->rank() == 0;
+        }
+
         double best_val_loss = std::numeric_limits<double>::infinity();
         int no_improve = 0;
         for(int i=1;i<=epochs;i++){
             double epoch_loss = 0;
-            for(int j=0;j<features.getRows();j+=batchSize){
-                Matrix batch_features=features.subset_rows(j,std::min(j+batchSize,features.getRows()));
-                Matrix batch_targets=targets.subset_rows(j,std::min(j+batchSize,features.getRows()));
+            for(int j=0;j<row_count;j+=batchSize){
+                load_rows(row_begin+j,row_begin+std::min(j+batchSize,row_count),planner.activation(0));
+                Matrix batch_targets=targets.subset_rows(row_begin+j,row_begin+std::min(j+batchSize,row_count));
 
-                Matrix pred=predict(batch_features);
-                Matrix grad=calculate_loss_derivative(pred,batch_targets);
-
-                for(int k=this->layers.size()-1;k>=0;k--){
-                    grad=this->layers[k]->backward(grad);
-                }
-                double batch_loss=calculate_loss(pred, batch_targets);
+                double batch_loss=train_step(batch_targets);
                 epoch_loss += batch_loss;
-                int progress = (j * 100) / features.getRows();
-                if (progress % 10 == 0 && (j == 0 || (j * 100) / features.getRows() != ((j - batchSize) * 100) / features.getRows())) {
-                    std::cout << "Epoch Progress: " << progress << "% - Batch " << std::min(j + batchSize, features.getRows()) 
-                              << "/" << features.getRows() << " - Loss: " << batch_loss << "\n";
+                int progress = (j * 100) / row_count;
+                if (verbose && progress % 10 == 0 && (j == 0 || (j * 100) / row_count != ((j - batchSize) * 100) / row_count)) {
+                    std::cout << "Epoch Progress: " << progress << "% - Batch " << std::min(j + batchSize, row_count) 
+                              << "/" << row_count << " - Loss: " << batch_loss << "\n";
                 }
             }
-            epoch_loss /= (features.getRows() / batchSize);
-            Matrix val_predictions=predict(val_features);
-            double val_loss = calculate_loss(val_predictions, val_targets);
+            epoch_loss /= (row_count / batchSize);
+            if(reducer){
+                comm->allreduce_sum(&epoch_loss, 1);
+                epoch_loss /= comm->size();
+            }
+            EvaluationAccumulator val_acc = make_accumulator(1);
+            if(reducer){
+                //each rank scores its share of the validation rows; summing the raw totals
+                //gives every rank the same loss, so they all stop at the same epoch
+                int val_begin = (int)((long long)num_val_rows * comm->rank() / comm->size());
+                int val_end = (int)((long long)num_val_rows * (comm->rank() + 1) / comm->size());
+                accumulate_rows(load_val, val_begin, val_end, val_targets, 1024, val_acc);
+                val_acc.reduce([&](double *data, size_t n) { comm->allreduce_sum(data, n); });
+            } else {
+                accumulate_rows(load_val, 0, num_val_rows, val_targets, 1024, val_acc);
+            }
+            Evaluation val = val_acc.finish();
+            double val_loss = val.loss;
+            if(epoch_callback && !epoch_callback(i, val_loss)) break;
             
             // Early stopping
             if(val_loss < best_val_loss) {
@@ -132,21 +395,28 @@ namespace galanet{
                 if(no_improve >= patience) break;
             }
 
-            std::cout << "Epoch " << i << "/" << epochs 
-                  << " - loss: " << epoch_loss / (features.getRows()/batchSize)
+            if(verbose)
+                std::cout << "Epoch " << i << "/" << epochs 
+                  << " - loss: " << epoch_loss / (row_count/batchSize)
                   << " - val_loss: " << val_loss 
-                  << " - val_accuracy: " << calc_accuracy(val_predictions, val_targets) << "\n";
+                  << " - val_accuracy: " << val.accuracy << "\n";
 
         }
     }
 
     Matrix NN::calculate_loss_derivative(const Matrix& predictions, const Matrix& targets){
+        Matrix res;
+        calculate_loss_derivative(predictions, targets, res);
+        return res;
+    }
+
+    void NN::calculate_loss_derivative(const Matrix& predictions, const Matrix& targets, Matrix &out){
         if(this->loss_name=="cross_entropy")
-            return galanet::loss::crossEntropyLossDerivative(predictions,targets);
+            galanet::loss::crossEntropyLossDerivative(predictions,targets,out);
         else if(this->loss_name=="mean_squared_error" || this->loss_name=="mse")
-            return galanet::loss::meanSquaredErrorDerivative(predictions,targets);
+            galanet::loss::meanSquaredErrorDerivative(predictions,targets,out);
         else if(this->loss_name=="mean_absolute_error" || this->loss_name=="mae")
-            return galanet::loss::meanAbsoluteErrorDerivative(predictions,targets);
+            galanet::loss::meanAbsoluteErrorDerivative(predictions,targets,out);
         else throw std::invalid_argument("Invalid loss function");
     }
 
@@ -161,6 +431,52 @@ namespace galanet{
     }
     
 
+    Evaluation NN::evaluate(const Matrix &features, const Matrix &targets, int top_k, int chunk_rows){
+        return evaluate_rows([&](int start, int end, Matrix &out) { features.subset_rows(start, end, out); }, features.getRows(), targets, top_k, chunk_rows);
+    }
+
+    Evaluation NN::evaluate(const ByteDataset &features, const Matrix &targets, int top_k, int chunk_rows){
+        return evaluate_rows([&](int start, int end, Matrix &out) { features.gather_rows(start, end, out); }, features.getRows(), targets, top_k, chunk_rows);
+    }
+
+    Evaluation NN::evaluate_rows(const RowLoader &load_rows, int num_rows, const Matrix &targets, int top_k, int chunk_rows){
+        if(num_rows != targets.getRows()) throw std::invalid_argument("Shape mismatch");
+        EvaluationAccumulator acc = make_accumulator(top_k);
+        accumulate_rows(load_rows, 0, num_rows, targets, chunk_rows, acc);
+        return acc.finish();
+    }
+
+    EvaluationAccumulator NN::make_accumulator(int top_k) const{
+        if(this->layers.empty()) throw std::invalid_argument("Network has no layers");
+        EvaluationAccumulator::SampleLoss sample_loss;
+        if(this->loss_name=="cross_entropy")
+            sample_loss = galanet::loss::crossEntropySample;
+        else if(this->loss_name=="mean_squared_error" || this->loss_name=="mse")
+            sample_loss = galanet::loss::meanSquaredErrorSample;
+        else if(this->loss_name=="mean_absolute_error" || this->loss_name=="mae")
+            sample_loss = galanet::loss::meanAbsoluteErrorSample;
+        else throw std::invalid_argument("Invalid loss function");
+        const int classes = this->layers.back()->getOutDim();
+        return EvaluationAccumulator(classes, std::min(top_k, classes), sample_loss);
+    }
+
+    void NN::accumulate_rows(const RowLoader &load_rows, int row_begin, int row_end, const Matrix &targets, int chunk_rows, EvaluationAccumulator &acc){
+        if(chunk_rows <= 0) throw std::invalid_argument("chunk_rows must be positive");
+        //ping-pong buffers sized for one chunk, reused across chunks
+        Matrix buffers[2];
+        for(int start=row_begin;start<row_end;start+=chunk_rows){
+            load_rows(start, std::min(start+chunk_rows,row_end), buffers[0]);
+            int current = 0;
+            on_local_node([&] {
+                for(auto &layer : this->layers){
+                    layer->infer(buffers[current], buffers[1 - current]);
+                    current = 1 - current;
+                }
+            });
+            acc.add(buffers[current], targets, start);
+        }
+    }
+
     double NN::calc_accuracy(const Matrix& pred, const Matrix& targets){
         int t = 0;
         #pragma omp parallel for reduction(+:t)
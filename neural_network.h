@@ -2,38 +2,113 @@
 #define NEURAL_NETWORK_H
 #include "matrix.h"
 #include "weights_initializer.h"
+#include "memory_planner.h"
+#include "distributed.h"
+#include "dataset.h"
+#include "evaluation.h"
 
+#include <functional>
 #include <memory>
 #include <string>
 namespace galanet {
     class DenseLayer{
         public:
             DenseLayer(int in_dim, int out_dim, std::string activation_name, std::string weight_init_name, double learning_rate);
-            Matrix forward(const Matrix &inputs);
-            Matrix backward(Matrix &grad);
+            Matrix forward(const Matrix &inputs); //inference, keeps no state
+            void infer(const Matrix &inputs, Matrix &outputs); //inference into a reused buffer
+            // Training forward pass into outputs; ReLU layers record their sign mask when mask is given.
+            void forward(const Matrix &inputs, Matrix &outputs, BitMask *mask);
+            // Turns grad (dL/doutputs) into dL/dz in place and writes dL/dinputs into input_grad
+            // unless it is null. With store_gradients the parameter gradients are kept for
+            // apply_gradients() (e.g. to average them across ranks first); otherwise the SGD
+            // step is fused into the weight-gradient GEMM.
+            void backward(const Matrix &inputs, const Matrix &outputs, const BitMask &mask, Matrix &grad, Matrix *input_grad, bool store_gradients);
+            void apply_gradients(); //SGD update from the last backward; drops the weight replicas
+            // Read-only copy of the weights in every NUMA node's memory; the inference
+            // forward then reads the copy local to the calling thread.
+            void replicate_weights();
+            void drop_weight_replicas();
+            bool has_weight_replicas() const;
+            int getInDim() const;
+            int getOutDim() const;
+            Matrix &getWeights();
+            Matrix &getBias();
+            Matrix &getWeightsGrad();
+            Matrix &getBiasGrad();
+            const std::string &getActivationName() const;
+            bool needsMask() const;
         protected:
+            void forward(const Matrix &inputs, Matrix &outputs, BitMask *mask, const Matrix &weights, const Matrix &bias);
             int in_dim;
             int out_dim;
             double learning_rate;
-            Matrix last_inputs;
-            Matrix pre_activation;  
             std::string weight_init_name;
             std::string activation_name;
             Matrix weights;
             Matrix bias;
+            Matrix weights_grad;
+            Matrix bias_grad;
+            std::vector<Matrix> weight_replicas; //one per NUMA node, empty when not replicated
+            std::vector<Matrix> bias_replicas;
     };
     class NN {
         public: 
             NN(std::string loss_name) ;
             void add_layer(std::unique_ptr<DenseLayer> layer);
+            int num_layers() const;
+            DenseLayer &getLayer(int index);
             void train(const Matrix &features, const Matrix &targets, const Matrix &val_features = Matrix(0,0), const Matrix &val_targets = Matrix(0,0), int epochs=10, int batchSize = 48, int patience = 5);
+            // Same as above on a compact uint8 dataset; batches are converted as they are drawn.
+            void train(const ByteDataset &features, const Matrix &targets, const ByteDataset &val_features, const Matrix &val_targets, int epochs=10, int batchSize = 48, int patience = 5);
             Matrix predict(const Matrix &features);
+            Matrix predict(const ByteDataset &features, int chunk_rows = 1024);
             double calc_accuracy(const Matrix& features, const Matrix& targets);
+            // Runs the dataset through the network chunk_rows at a time and reduces each chunk
+            // straight into loss, top-1/top-k accuracy and the confusion matrix (from which
+            // per-class precision and recall follow), so only one chunk of predictions exists.
+            Evaluation evaluate(const Matrix &features, const Matrix &targets, int top_k = 5, int chunk_rows = 1024);
+            Evaluation evaluate(const ByteDataset &features, const Matrix &targets, int top_k = 5, int chunk_rows = 1024);
             double calculate_loss(const Matrix& predictions, const Matrix& targets);
             Matrix calculate_loss_derivative(const Matrix& predictions, const Matrix& targets);
+            void calculate_loss_derivative(const Matrix& predictions, const Matrix& targets, Matrix &out); //into out's storage
+            // Keep only every segment_length-th activation during training and recompute the
+            // rest in backward; 0 picks ceil(sqrt(#layers)).
+            void enable_checkpointing(int segment_length = 0);
+            void disable_checkpointing();
+            size_t activation_memory_bytes() const;
+            // For inference on multi-socket machines: keeps a copy of every layer's weights
+            // on each NUMA node. predict() and evaluate() then run on a team confined to the
+            // caller's node, all reading that node's copy, so serving threads should be bound
+            // to a node (numa::bind_current_thread). Training drops the copies.
+            void replicate_weights();
+            // Data-parallel training: train() uses this rank's shard of the data, starts from
+            // rank 0's parameters and averages gradients across ranks every step, reducing
+            // buckets of about bucket_bytes while backward is still running. nullptr disables.
+            void set_communicator(distributed::Communicator *comm, size_t bucket_bytes = 1 << 18);
+            void set_verbose(bool verbose);
+            // Called after every epoch with its validation loss; returning false stops training.
+            void set_epoch_callback(std::function<bool(int epoch, double val_loss)> callback);
         private:
+            // Loads rows [start, end) of the training features into out.
+            using RowLoader = std::function<void(int start, int end, Matrix &out)>;
+            void train_rows(const RowLoader &load_rows, int num_rows, const Matrix &targets, const RowLoader &load_val, int num_val_rows, const Matrix &val_targets, int epochs, int batchSize, int patience);
+            Evaluation evaluate_rows(const RowLoader &load_rows, int num_rows, const Matrix &targets, int top_k, int chunk_rows);
+            EvaluationAccumulator make_accumulator(int top_k) const;
+            // Adds rows [row_begin, row_end) to acc, chunk_rows at a time.
+            void accumulate_rows(const RowLoader &load_rows, int row_begin, int row_end, const Matrix &targets, int chunk_rows, EvaluationAccumulator &acc);
+            // Runs fn directly, or with replicated weights on a team of the calling thread's node.
+            void on_local_node(const std::function<void()> &fn);
+            void sync_parameters();
+            double train_step(const Matrix &batch_targets);
             std::vector<std::unique_ptr<DenseLayer>> layers;
             std::string loss_name;
+            MemoryPlanner planner;
+            bool checkpointing = false;
+            int checkpoint_segment = 0;
+            distributed::Communicator *comm = nullptr;
+            std::unique_ptr<distributed::GradientReducer> reducer;
+            bool verbose = true;
+            std::function<bool(int, double)> epoch_callback;
     };
 }
 #endif
\ No newline at end of file
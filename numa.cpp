@@ -0,0 +1,189 @@
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <exception>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#include <dirent.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "numa.h"
+
+namespace galanet::numa {
+    struct Topology {
+        std::vector<std::vector<int>> nodes; //allowed CPUs of every node that has any
+        std::vector<int> cpu_node;           //node index by CPU id, -1 when unknown
+        std::vector<int> allowed;            //CPUs the process could use at startup
+    };
+
+    //"0-3,8-11" -> {0,1,2,3,8,9,10,11}
+    static std::vector<int> parse_cpulist(const std::string &list){
+        std::vector<int> cpus;
+        std::stringstream ranges(list);
+        std::string range;
+        while(std::getline(ranges, range, ',')){
+            if(range.empty() || range == "\n") continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for(int c = first; c <= last; c++) cpus.push_back(c);
+        }
+        return cpus;
+    }
+
+    static Topology load_topology(){
+        Topology topo;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(sched_getaffinity(0, sizeof(set), &set) == 0)
+            for(int c = 0; c < CPU_SETSIZE; c++)
+                if(CPU_ISSET(c, &set)) topo.allowed.push_back(c);
+        if(topo.allowed.empty()) topo.allowed.push_back(0);
+        topo.cpu_node.assign(topo.allowed.back() + 1, -1);
+
+        std::vector<int> node_ids;
+        if(DIR *dir = opendir("/sys/devices/system/node")){
+            while(dirent *entry = readdir(dir)){
+                std::string name = entry->d_name;
+                if(name.rfind("node", 0) == 0 && name.size() > 4 && std::all_of(name.begin() + 4, name.end(), ::isdigit))
+                    node_ids.push_back(std::stoi(name.substr(4)));
+            }
+            closedir(dir);
+        }
+        std::sort(node_ids.begin(), node_ids.end());
+        for(int id : node_ids){
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+            std::string list;
+            std::getline(file, list);
+            std::vector<int> cpus;
+            for(int c : parse_cpulist(list))
+                if(std::binary_search(topo.allowed.begin(), topo.allowed.end(), c)) cpus.push_back(c);
+            if(cpus.empty()) continue; //memory-only node or none of its CPUs are ours
+            for(int c : cpus) topo.cpu_node[c] = topo.nodes.size();
+            topo.nodes.push_back(cpus);
+        }
+        if(topo.nodes.empty()){
+            topo.nodes.push_back(topo.allowed);
+            for(int c : topo.allowed) topo.cpu_node[c] = 0;
+        }
+        return topo;
+    }
+
+    static const Topology &topology(){
+        static const Topology topo = load_topology();
+        return topo;
+    }
+
+    static std::atomic<bool> first_touch_enabled{false};
+
+    int num_nodes(){
+        return topology().nodes.size();
+    }
+
+    std::vector<int> node_cpus(int node){
+        if(node < 0 || node >= num_nodes()) throw std::invalid_argument("Invalid NUMA node");
+        return topology().nodes[node];
+    }
+
+    int current_node(){
+        const Topology &topo = topology();
+        int cpu = sched_getcpu();
+        if(cpu < 0 || cpu >= (int)topo.cpu_node.size() || topo.cpu_node[cpu] < 0) return 0;
+        return topo.cpu_node[cpu];
+    }
+
+    void bind_current_thread(const std::vector<int> &cpus){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int c : cpus) CPU_SET(c, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    void bind_current_thread(int node){
+        bind_current_thread(node_cpus(node));
+    }
+
+    //CPUs ordered node by node; picking every (cpus / threads)-th one spreads a team evenly over the nodes
+    static std::vector<int> ordered_cpus(){
+        const Topology &topo = topology();
+        std::vector<int> order;
+        for(const std::vector<int> &cpus : topo.nodes)
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        return order;
+    }
+
+    std::vector<int> partition_cpus(int part, int parts){
+        if(parts < 1 || part < 0 || part >= parts) throw std::invalid_argument("Invalid CPU partition");
+        const Topology &topo = topology();
+        const int nodes = topo.nodes.size();
+        std::vector<int> res;
+        if(nodes >= parts){
+            for(int n = 0; n < nodes; n++)
+                if(n * parts / nodes == part)
+                    res.insert(res.end(), topo.nodes[n].begin(), topo.nodes[n].end());
+            return res;
+        }
+        const std::vector<int> cpus = ordered_cpus();
+        const size_t count = cpus.size();
+        if((size_t)parts > count) return {cpus[part % count]};
+        for(size_t c = part * count / parts; c < (part + 1) * count / parts; c++)
+            res.push_back(cpus[c]);
+        return res;
+    }
+
+    void pin_threads(){
+        const std::vector<int> cpus = ordered_cpus();
+    #ifdef _OPENMP
+        #pragma omp parallel
+        {
+            const size_t t = omp_get_thread_num(), threads = omp_get_num_threads();
+            bind_current_thread(std::vector<int>{cpus[t * cpus.size() / threads]});
+        }
+    #else
+        bind_current_thread(std::vector<int>{cpus.front()});
+    #endif
+    }
+
+    void unpin_threads(){
+        const std::vector<int> &allowed = topology().allowed;
+    #ifdef _OPENMP
+        #pragma omp parallel
+    #endif
+        bind_current_thread(allowed);
+    }
+
+    void set_first_touch(bool enabled){
+        first_touch_enabled = enabled;
+    }
+
+    bool first_touch(){
+        return first_touch_enabled;
+    }
+
+    void run_on_node(int node, const std::function<void()> &fn, int threads){
+        if(threads < 1) throw std::invalid_argument("Thread count must be positive");
+        const std::vector<int> cpus = node_cpus(node);
+        std::exception_ptr error;
+        std::thread worker([&] {
+            bind_current_thread(cpus);
+        #ifdef _OPENMP
+            omp_set_num_threads(threads);
+        #endif
+            try {
+                fn();
+            } catch (...) {
+                error = std::current_exception();
+            }
+        });
+        worker.join();
+        if(error) std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef NUMA_H
+#define NUMA_H
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace galanet::numa {
+    // Topology is read from /sys/devices/system/node; without it the machine
+    // is treated as a single node holding every CPU.
+    int num_nodes();
+    std::vector<int> node_cpus(int node); //restricted to the CPUs this process may run on
+    int current_node();                   //node of the CPU the calling thread is running on
+
+    // Restricts the calling thread to the CPUs of one node, or to the given CPUs.
+    void bind_current_thread(int node);
+    void bind_current_thread(const std::vector<int> &cpus);
+    // CPUs of group part out of parts disjoint groups: whole nodes when there are
+    // at least as many nodes as groups, otherwise an even slice of the CPUs taken
+    // node by node (groups share CPUs round-robin only when they outnumber them).
+    std::vector<int> partition_cpus(int part, int parts);
+    // Pins each thread of the calling thread's OpenMP team to one CPU, spread
+    // evenly over the nodes, so threads stop migrating between sockets. Teams
+    // are reused by the runtime, so this holds until the thread count changes.
+    void pin_threads();
+    // Lets the team run anywhere again.
+    void unpin_threads();
+
+    // With first touch on, Matrix buffers of at least FIRST_TOUCH_MIN_BYTES are
+    // initialized by the OpenMP team with the static row partition the kernels
+    // use, so each page is placed on the node of the thread that works on it.
+    // Off by default: it starts OpenMP inside constructors, which must not happen
+    // in a process that forks afterwards (see distributed::launch).
+    constexpr size_t FIRST_TOUCH_MIN_BYTES = 1 << 18;
+    void set_first_touch(bool enabled);
+    bool first_touch();
+
+    // Runs fn on a thread bound to node with an OpenMP team of threads threads,
+    // so everything it allocates and writes ends up in that node's memory. The
+    // team is started by that thread and inherits its binding.
+    void run_on_node(int node, const std::function<void()> &fn, int threads = 1);
+
+    // std::allocator that leaves elements default-initialized, so resizing a
+    // vector of doubles allocates without writing (and placing) the pages.
+    template <typename T>
+    struct DefaultInitAllocator : std::allocator<T> {
+        template <typename U> struct rebind { using other = DefaultInitAllocator<U>; };
+        DefaultInitAllocator() = default;
+        template <typename U> DefaultInitAllocator(const DefaultInitAllocator<U> &) noexcept {}
+        template <typename U> void construct(U *p) noexcept(std::is_nothrow_default_constructible<U>::value) {
+            ::new (static_cast<void *>(p)) U;
+        }
+        template <typename U, typename... Args> void construct(U *p, Args &&...args) {
+            ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+        }
+    };
+}
+#endif
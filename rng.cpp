@@ -0,0 +1,94 @@
+#include <atomic>
+
+#include "rng.h"
+
+namespace galanet::rng {
+    static std::atomic<uint64_t> global_seed{0};
+    static std::atomic<uint64_t> stream_counter{0};
+    static thread_local ThreadStreams *thread_streams = nullptr;
+
+    static inline void mulhilo(uint32_t a, uint32_t b, uint32_t &hi, uint32_t &lo){
+        uint64_t product = (uint64_t)a * b;
+        hi = product >> 32;
+        lo = (uint32_t)product;
+    }
+
+    static inline std::array<uint32_t, 4> philox_block(uint64_t index, uint64_t stream, uint64_t key){
+        std::array<uint32_t, 4> counter = {(uint32_t)index, (uint32_t)(index >> 32), (uint32_t)stream, (uint32_t)(stream >> 32)};
+        return philox4x32(counter, key);
+    }
+
+    //top 53 bits of two outputs mapped to [0, 1)
+    static inline double to_unit(uint32_t a, uint32_t b){
+        return (double)((((uint64_t)a << 32) | b) >> 11) * 0x1.0p-53;
+    }
+
+    std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> c, uint64_t key){
+        uint32_t k0 = (uint32_t)key;
+        uint32_t k1 = (uint32_t)(key >> 32);
+        for(int round = 0; round < 10; round++){
+            uint32_t hi0, lo0, hi1, lo1;
+            mulhilo(0xD2511F53u, c[0], hi0, lo0);
+            mulhilo(0xCD9E8D57u, c[2], hi1, lo1);
+            c = {hi1 ^ c[1] ^ k0, lo1, hi0 ^ c[3] ^ k1, lo0};
+            k0 += 0x9E3779B9u;
+            k1 += 0xBB67AE85u;
+        }
+        return c;
+    }
+
+    void set_seed(uint64_t seed){
+        global_seed.store(seed);
+        stream_counter.store(0);
+    }
+
+    uint64_t get_seed(){
+        if(thread_streams != nullptr) return thread_streams->seed;
+        return global_seed.load();
+    }
+
+    uint64_t next_stream_id(){
+        if(thread_streams != nullptr) return thread_streams->next_stream++;
+        return stream_counter.fetch_add(1);
+    }
+
+    ThreadStreams::ThreadStreams(uint64_t seed) : previous(thread_streams), seed(seed) {
+        thread_streams = this;
+    }
+
+    ThreadStreams::~ThreadStreams(){
+        thread_streams = previous;
+    }
+
+    void fill_uniform(double *out, size_t n, double min_val, double max_val, uint64_t seed, uint64_t stream){
+        const double range = max_val - min_val;
+        //one Philox block yields two doubles
+        const size_t pairs = n / 2;
+        #pragma omp parallel for simd
+        for(size_t p = 0; p < pairs; p++){
+            std::array<uint32_t, 4> r = philox_block(p, stream, seed);
+            out[2 * p] = min_val + range * to_unit(r[0], r[1]);
+            out[2 * p + 1] = min_val + range * to_unit(r[2], r[3]);
+        }
+        if(n % 2){
+            std::array<uint32_t, 4> r = philox_block(pairs, stream, seed);
+            out[n - 1] = min_val + range * to_unit(r[0], r[1]);
+        }
+    }
+
+    Generator::Generator(uint64_t seed, uint64_t stream) : seed(seed), stream(stream) {}
+
+    Generator::result_type Generator::operator()(){
+        if(used == 4){
+            buffer = philox_block(block++, stream, seed);
+            used = 0;
+        }
+        return buffer[used++];
+    }
+
+    double Generator::uniform(){
+        uint32_t a = (*this)();
+        uint32_t b = (*this)();
+        return to_unit(a, b);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef RNG_H
+#define RNG_H
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace galanet::rng {
+    // Philox4x32-10 (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3").
+    // A pure function of (counter, key), so any element can be generated
+    // independently and in any order.
+    std::array<uint32_t, 4> philox4x32(std::array<uint32_t, 4> counter, uint64_t key);
+
+    // Global seed used by the weight initializers; defaults to 0 so runs are
+    // reproducible unless a seed is set explicitly.
+    void set_seed(uint64_t seed);
+    uint64_t get_seed();
+    // Each consumer (one initialized matrix, one shuffle, ...) takes its own
+    // stream id; ids restart from 0 whenever the seed is set.
+    uint64_t next_stream_id();
+
+    // While alive, gives the constructing thread its own seed and stream
+    // counter starting at 0, so models built concurrently get the same weights
+    // as a standalone run after set_seed(seed), whatever the scheduling.
+    class ThreadStreams {
+        public:
+            explicit ThreadStreams(uint64_t seed);
+            ~ThreadStreams();
+            ThreadStreams(const ThreadStreams &) = delete;
+            ThreadStreams &operator=(const ThreadStreams &) = delete;
+        private:
+            friend uint64_t get_seed();
+            friend uint64_t next_stream_id();
+            ThreadStreams *previous;
+            uint64_t seed;
+            uint64_t next_stream = 0;
+    };
+
+    // Fills out[0..n) with uniform values in [min_val, max_val). Element i only
+    // depends on (seed, stream, i), so the result is bit-identical for any
+    // number of threads.
+    void fill_uniform(double *out, size_t n, double min_val, double max_val, uint64_t seed, uint64_t stream);
+
+    // Sequential view of one stream, usable as a UniformRandomBitGenerator
+    // (e.g. with std::shuffle or std distributions).
+    class Generator {
+        public:
+            using result_type = uint32_t;
+            Generator(uint64_t seed, uint64_t stream);
+            static constexpr result_type min() { return 0; }
+            static constexpr result_type max() { return std::numeric_limits<uint32_t>::max(); }
+            result_type operator()();
+            double uniform(); //in [0, 1)
+        private:
+            uint64_t seed;
+            uint64_t stream;
+            uint64_t block = 0;
+            std::array<uint32_t, 4> buffer{};
+            int used = 4;
+    };
+}
+#endif
\ No newline at end of file
@@ -0,0 +1,162 @@
+#ifndef STATIC_NETWORK_H
+#define STATIC_NETWORK_H
+#include "matrix.h"
+#include "neural_network.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+namespace galanet {
+    // Activations of the fixed-topology network, resolved at compile time. Each
+    // matches the corresponding DenseLayer activation bit for bit.
+    struct ReLU {
+        static constexpr const char *name = "relu";
+        template <int N> static void apply(double *x) {
+            #pragma omp simd
+            for (int j = 0; j < N; j++)
+                x[j] = x[j] > 0 ? x[j] : 0;
+        }
+    };
+    struct Tanh {
+        static constexpr const char *name = "tanh";
+        template <int N> static void apply(double *x) {
+            for (int j = 0; j < N; j++)
+                x[j] = std::tanh(x[j]);
+        }
+    };
+    struct Softmax {
+        static constexpr const char *name = "softmax";
+        template <int N> static void apply(double *x) {
+            double rowMax = -std::numeric_limits<double>::infinity();
+            for (int j = 0; j < N; j++)
+                rowMax = std::max(rowMax, x[j]);
+            double sumExp = 0.0;
+            for (int j = 0; j < N; j++) {
+                x[j] = std::exp(x[j] - rowMax);
+                sumExp += x[j];
+            }
+            for (int j = 0; j < N; j++)
+                x[j] /= sumExp;
+        }
+    };
+
+    // Dense layer with its shape and activation fixed at compile time. Weights
+    // live inline (In * Out doubles), so the layer is a plain value: give large
+    // networks static storage rather than putting them on the stack.
+    template <int In, int Out, typename Activation>
+    class StaticDense {
+        public:
+            static_assert(In > 0 && Out > 0, "StaticDense dimensions must be positive");
+            static constexpr int in_dim = In;
+            static constexpr int out_dim = Out;
+
+            // Copies the parameters of a trained layer of the same shape and activation.
+            void import_from(DenseLayer &layer) {
+                if (layer.getInDim() != In || layer.getOutDim() != Out)
+                    throw std::invalid_argument("Layer shape does not match StaticDense");
+                if (layer.getActivationName() != Activation::name)
+                    throw std::invalid_argument("Layer activation does not match StaticDense");
+                const double *w = layer.getWeights().data();
+                std::copy(w, w + (size_t)In * Out, weights.begin());
+                const double *b = layer.getBias().data();
+                std::copy(b, b + Out, bias.begin());
+            }
+
+            // out = activation(in * W + b) for one sample. The sum over inputs runs in
+            // ascending order like Matrix::gemm, so results match DenseLayer exactly.
+            void forward(const double *in, double *out) const {
+                alignas(64) double acc[Out] = {};
+                constexpr int K4 = In - In % 4;
+                //four inputs per pass over acc, still added one after another
+                for (int k = 0; k < K4; k += 4) {
+                    const double x0 = in[k], x1 = in[k + 1], x2 = in[k + 2], x3 = in[k + 3];
+                    const double *w0 = weights.data() + (size_t)k * Out;
+                    #pragma omp simd
+                    for (int j = 0; j < Out; j++)
+                        acc[j] = acc[j] + x0 * w0[j] + x1 * w0[Out + j] + x2 * w0[2 * Out + j] + x3 * w0[3 * Out + j];
+                }
+                for (int k = K4; k < In; k++) {
+                    const double xk = in[k];
+                    const double *wrow = weights.data() + (size_t)k * Out;
+                    #pragma omp simd
+                    for (int j = 0; j < Out; j++)
+                        acc[j] += xk * wrow[j];
+                }
+                #pragma omp simd
+                for (int j = 0; j < Out; j++)
+                    out[j] = acc[j] + bias[j];
+                Activation::template apply<Out>(out);
+            }
+        private:
+            alignas(64) std::array<double, (size_t)In * Out> weights{};
+            alignas(64) std::array<double, Out> bias{};
+    };
+
+    // Inference-only network of StaticDense layers, e.g.
+    //   static StaticNN<StaticDense<784, 128, ReLU>, StaticDense<128, 10, Softmax>> net;
+    // Intermediate activations are stack arrays sized at compile time, and no
+    // allocation or string comparison happens per prediction.
+    template <typename... Layers>
+    class StaticNN {
+        public:
+            static_assert(sizeof...(Layers) > 0, "StaticNN needs at least one layer");
+            using LayerTuple = std::tuple<Layers...>;
+            static constexpr size_t num_layers = sizeof...(Layers);
+            static constexpr int in_dim = std::tuple_element_t<0, LayerTuple>::in_dim;
+            static constexpr int out_dim = std::tuple_element_t<num_layers - 1, LayerTuple>::out_dim;
+
+            // Copies the parameters of a trained NN with the same topology.
+            void import_from(NN &nn) {
+                if (nn.num_layers() != (int)num_layers)
+                    throw std::invalid_argument("Network depth does not match StaticNN");
+                import_layers<0>(nn);
+            }
+
+            void predict(const double *in, double *out) const {
+                forward_from<0>(in, out);
+            }
+            std::array<double, out_dim> predict(const std::array<double, in_dim> &in) const {
+                std::array<double, out_dim> out;
+                forward_from<0>(in.data(), out.data());
+                return out;
+            }
+            // Row by row, for comparison with NN::predict.
+            Matrix predict(const Matrix &features) const {
+                if (features.getCols() != in_dim) throw std::invalid_argument("Shape not compatible with StaticNN input");
+                Matrix res(features.getRows(), out_dim);
+                #pragma omp parallel for
+                for (int i = 0; i < features.getRows(); i++)
+                    forward_from<0>(features.data() + (size_t)i * in_dim, res.data() + (size_t)i * out_dim);
+                return res;
+            }
+        private:
+            template <size_t I>
+            void import_layers(NN &nn) {
+                if constexpr (I < num_layers) {
+                    std::get<I>(layers).import_from(nn.getLayer(I));
+                    import_layers<I + 1>(nn);
+                }
+            }
+
+            template <size_t I>
+            void forward_from(const double *in, double *out) const {
+                using Layer = std::tuple_element_t<I, LayerTuple>;
+                if constexpr (I + 1 == num_layers) {
+                    std::get<I>(layers).forward(in, out);
+                } else {
+                    static_assert(Layer::out_dim == std::tuple_element_t<I + 1, LayerTuple>::in_dim, "Consecutive StaticDense layers must have matching dimensions");
+                    alignas(64) double hidden[Layer::out_dim];
+                    std::get<I>(layers).forward(in, hidden);
+                    forward_from<I + 1>(hidden, out);
+                }
+            }
+
+            LayerTuple layers;
+    };
+}
+#endif
@@ -0,0 +1,193 @@
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <limits>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <pthread.h>
+#include <sched.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "sweep.h"
+#include "neural_network.h"
+#include "rng.h"
+
+namespace galanet::sweep {
+    std::vector<TrialConfig> grid(const std::vector<double> &learning_rates, const std::vector<int> &batch_sizes, const std::vector<std::vector<int>> &hidden_widths, int epochs, int patience){
+        std::vector<TrialConfig> configs;
+        for(double lr : learning_rates)
+            for(int batch : batch_sizes)
+                for(const std::vector<int> &widths : hidden_widths){
+                    TrialConfig config;
+                    config.learning_rate = lr;
+                    config.batch_size = batch;
+                    config.hidden_widths = widths;
+                    config.epochs = epochs;
+                    config.patience = patience;
+                    configs.push_back(config);
+                }
+        return configs;
+    }
+
+    static std::vector<int> available_cpus(){
+        std::vector<int> cpus;
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if(sched_getaffinity(0, sizeof(set), &set) == 0)
+            for(int c = 0; c < CPU_SETSIZE; c++)
+                if(CPU_ISSET(c, &set)) cpus.push_back(c);
+        if(cpus.empty()) cpus.push_back(0);
+        return cpus;
+    }
+
+    //OpenMP threads started later by this thread inherit its affinity
+    static void pin_current_thread(const std::vector<int> &cpus){
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for(int c : cpus) CPU_SET(c, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    #ifdef _OPENMP
+        omp_set_num_threads(cpus.size());
+    #endif
+    }
+
+    // Median stopping rule over the validation losses reported so far.
+    class MedianPruner {
+        public:
+            MedianPruner(const SweepOptions &options) : options(options) {}
+            bool should_prune(int epoch, double val_loss){
+                std::lock_guard<std::mutex> lock(mutex);
+                if((int)history.size() < epoch) history.resize(epoch);
+                std::vector<double> &reports = history[epoch - 1];
+                reports.push_back(val_loss);
+                if(epoch < options.prune_warmup_epochs || (int)reports.size() < options.prune_min_trials) return false;
+                std::vector<double> sorted = reports;
+                std::nth_element(sorted.begin(), sorted.begin() + sorted.size() / 2, sorted.end());
+                return val_loss > sorted[sorted.size() / 2];
+            }
+        private:
+            const SweepOptions &options;
+            std::vector<std::vector<double>> history;
+            std::mutex mutex;
+    };
+
+    // How a trial reaches the data, so Matrix and ByteDataset sweeps share one driver.
+    struct TrialData {
+        int in_dim;
+        const Matrix &targets;
+        const Matrix &val_targets;
+        std::function<void(NN &, const TrialConfig &)> train;
+        std::function<Evaluation(NN &)> evaluate_val;
+    };
+
+    static TrialResult run_trial(const TrialConfig &config, uint64_t seed, MedianPruner &pruner, const TrialData &data){
+        auto start = std::chrono::steady_clock::now();
+        rng::ThreadStreams streams(seed);
+        NN nn(config.loss_name);
+        int in_dim = data.in_dim;
+        for(int width : config.hidden_widths){
+            std::string init = config.hidden_activation == "relu" ? "he" : "xavier";
+            nn.add_layer(std::make_unique<DenseLayer>(in_dim, width, config.hidden_activation, init, config.learning_rate));
+            in_dim = width;
+        }
+        nn.add_layer(std::make_unique<DenseLayer>(in_dim, data.targets.getCols(), "softmax", "xavier", config.learning_rate));
+        nn.set_verbose(false);
+
+        TrialResult result;
+        result.config = config;
+        result.best_val_loss = std::numeric_limits<double>::infinity();
+        nn.set_epoch_callback([&](int epoch, double val_loss) {
+            result.epochs_run = epoch;
+            result.final_val_loss = val_loss;
+            result.best_val_loss = std::min(result.best_val_loss, val_loss);
+            result.pruned = pruner.should_prune(epoch, val_loss);
+            return !result.pruned;
+        });
+        data.train(nn, config);
+        result.val_accuracy = data.evaluate_val(nn).accuracy;
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    }
+
+    static std::vector<TrialResult> run_trials(const std::vector<TrialConfig> &configs, const TrialData &data, const SweepOptions &options){
+        std::vector<TrialResult> results(configs.size());
+        if(configs.empty()) return results;
+        std::vector<int> cpus = available_cpus();
+        int concurrency = options.max_concurrent > 0 ? options.max_concurrent : std::min<int>(cpus.size(), configs.size());
+        concurrency = std::max(1, std::min<int>(concurrency, configs.size()));
+
+        //slot s owns a contiguous group of cores; with more slots than cores they share
+        std::vector<std::vector<int>> groups(concurrency);
+        if(concurrency <= (int)cpus.size()){
+            for(size_t c = 0; c < cpus.size(); c++)
+                groups[c * concurrency / cpus.size()].push_back(cpus[c]);
+        } else {
+            for(int s = 0; s < concurrency; s++)
+                groups[s].push_back(cpus[s % cpus.size()]);
+        }
+
+        const uint64_t seed = rng::get_seed();
+        MedianPruner pruner(options);
+        std::atomic<size_t> next_trial{0};
+        std::exception_ptr failure;
+        std::mutex failure_mutex;
+        std::vector<std::thread> workers;
+        for(int s = 0; s < concurrency; s++){
+            workers.emplace_back([&, s] {
+                pin_current_thread(groups[s]);
+                for(size_t t = next_trial++; t < configs.size(); t = next_trial++){
+                    try {
+                        results[t] = run_trial(configs[t], seed, pruner, data);
+                    } catch (...) {
+                        std::lock_guard<std::mutex> lock(failure_mutex);
+                        if(!failure) failure = std::current_exception();
+                        next_trial = configs.size();
+                    }
+                }
+            });
+        }
+        for(std::thread &worker : workers) worker.join();
+        if(failure) std::rethrow_exception(failure);
+
+        std::stable_sort(results.begin(), results.end(), [](const TrialResult &a, const TrialResult &b) {
+            return a.best_val_loss < b.best_val_loss;
+        });
+        return results;
+    }
+
+    std::vector<TrialResult> run(const std::vector<TrialConfig> &configs, const Matrix &features, const Matrix &targets, const Matrix &val_features, const Matrix &val_targets, const SweepOptions &options){
+        TrialData data{features.getCols(), targets, val_targets,
+            [&](NN &nn, const TrialConfig &config) { nn.train(features, targets, val_features, val_targets, config.epochs, config.batch_size, config.patience); },
+            [&](NN &nn) { return nn.evaluate(val_features, val_targets, 1); }};
+        return run_trials(configs, data, options);
+    }
+
+    std::vector<TrialResult> run(const std::vector<TrialConfig> &configs, const ByteDataset &features, const Matrix &targets, const ByteDataset &val_features, const Matrix &val_targets, const SweepOptions &options){
+        TrialData data{features.getCols(), targets, val_targets,
+            [&](NN &nn, const TrialConfig &config) { nn.train(features, targets, val_features, val_targets, config.epochs, config.batch_size, config.patience); },
+            [&](NN &nn) { return nn.evaluate(val_features, val_targets, 1); }};
+        return run_trials(configs, data, options);
+    }
+
+    void write_results(const std::vector<TrialResult> &results, const std::string &path){
+        std::ofstream file(path);
+        if(!file.is_open()) throw std::runtime_error("Cannot open " + path);
+        file << "learning_rate,batch_size,hidden_widths,best_val_loss,final_val_loss,val_accuracy,epochs_run,pruned,seconds\n";
+        for(const TrialResult &r : results){
+            std::string widths;
+            for(size_t i = 0; i < r.config.hidden_widths.size(); i++)
+                widths += (i ? "x" : "") + std::to_string(r.config.hidden_widths[i]);
+            file << r.config.learning_rate << "," << r.config.batch_size << "," << widths << ","
+                 << r.best_val_loss << "," << r.final_val_loss << "," << r.val_accuracy << ","
+                 << r.epochs_run << "," << (r.pruned ? "yes" : "no") << "," << r.seconds << "\n";
+        }
+    }
+}
\ No newline at end of file
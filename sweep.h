@@ -0,0 +1,48 @@
+#ifndef SWEEP_H
+#define SWEEP_H
+#include "matrix.h"
+#include "dataset.h"
+
+#include <string>
+#include <vector>
+namespace galanet::sweep {
+    struct TrialConfig {
+        double learning_rate = 0.0001;
+        int batch_size = 64;
+        std::vector<int> hidden_widths{128};
+        std::string hidden_activation = "relu";
+        std::string loss_name = "cross_entropy";
+        int epochs = 10;
+        int patience = 5;
+    };
+
+    struct TrialResult {
+        TrialConfig config;
+        double best_val_loss = 0;
+        double final_val_loss = 0;
+        double val_accuracy = 0;
+        int epochs_run = 0;
+        bool pruned = false;
+        double seconds = 0;
+    };
+
+    struct SweepOptions {
+        int max_concurrent = 0;        //0: one trial per available core, capped at the number of trials
+        int prune_warmup_epochs = 2;   //never prune before this many epochs
+        int prune_min_trials = 3;      //reports needed at an epoch before the median rule applies
+    };
+
+    // Every combination of the given values.
+    std::vector<TrialConfig> grid(const std::vector<double> &learning_rates, const std::vector<int> &batch_sizes, const std::vector<std::vector<int>> &hidden_widths, int epochs, int patience);
+
+    // Trains every configuration on the same read-only dataset, several at a
+    // time on threads pinned to disjoint sets of cores. Besides the per-trial
+    // patience rule, a trial is pruned when its validation loss is worse than
+    // the median of the other trials at the same epoch. Results are sorted by
+    // best validation loss.
+    std::vector<TrialResult> run(const std::vector<TrialConfig> &configs, const Matrix &features, const Matrix &targets, const Matrix &val_features, const Matrix &val_targets, const SweepOptions &options = SweepOptions());
+    std::vector<TrialResult> run(const std::vector<TrialConfig> &configs, const ByteDataset &features, const Matrix &targets, const ByteDataset &val_features, const Matrix &val_targets, const SweepOptions &options = SweepOptions());
+
+    void write_results(const std::vector<TrialResult> &results, const std::string &path);
+}
+#endif
\ No newline at end of file
@@ -1,11 +1,8 @@
-#include <random>
 #include <cmath>
 #include "weights_initializer.h"
+#include "rng.h"
 
 namespace galanet::weight_initializers {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-
     Matrix zeros(int num_rows, int num_cols) {
         return Matrix(num_rows, num_cols, 0);
     }
@@ -19,13 +16,8 @@ namespace galanet::weight_initializers {
     }
 
     Matrix random_uniform(int num_rows, int num_cols, double min_val, double max_val) {
-        std::uniform_real_distribution<double> dist(min_val, max_val);
         Matrix result(num_rows, num_cols);
-        for (int i = 0; i < num_rows; i++) {
-            for (int j = 0; j < num_cols; j++) {
-                result(i, j) = dist(gen);
-            }
-        }
+        rng::fill_uniform(result.data(), (size_t)num_rows * num_cols, min_val, max_val, rng::get_seed(), rng::next_stream_id());
         return result;
     }
 